@@ -0,0 +1,284 @@
+#include "LoRa-Compress.h"
+
+// marker, payload length, then the token groups
+#define COMPRESS_HEADER_SIZE  2
+
+#define COMPRESS_MAX_OFFSET   1024 // 10 bits, more than the whole history
+#define COMPRESS_HISTORY_SIZE (LORA_COMPRESS_MAX_DICTIONARY + LORA_COMPRESS_MAX_PAYLOAD)
+
+static_assert(COMPRESS_HISTORY_SIZE <= COMPRESS_MAX_OFFSET, "every match must be reachable");
+
+static uint8_t hash3(const uint8_t *p)
+{
+  return (uint8_t)(((p[0] << 4) ^ (p[1] << 2) ^ p[2]) * 0x9d >> (8 - LORA_COMPRESS_HASH_BITS));
+}
+
+LoRaCompressor::LoRaCompressor(LoRaClass &radio) :
+  _radio(radio),
+  _stats(),
+  _packetLength(0),
+  _dictionarySize(0)
+{
+  memset(_dictionaryHead, 0xff, sizeof(_dictionaryHead));
+}
+
+void LoRaCompressor::setDictionary(const uint8_t *dictionary, size_t size)
+{
+  if (!dictionary) {
+    size = 0;
+  } else if (size > LORA_COMPRESS_MAX_DICTIONARY) {
+    // the end is nearest to the data, keep that
+    dictionary += size - LORA_COMPRESS_MAX_DICTIONARY;
+    size = LORA_COMPRESS_MAX_DICTIONARY;
+  }
+
+  memcpy(_history, dictionary, size);
+  _dictionarySize = size;
+
+  // the last two positions need the frame's first bytes, compress() adds them
+  memset(_head, 0xff, sizeof(_head));
+  for (size_t i = 0; i + LORA_COMPRESS_MIN_MATCH <= size; i++) {
+    insert(i);
+  }
+  memcpy(_dictionaryHead, _head, sizeof(_head));
+}
+
+int LoRaCompressor::beginPacket()
+{
+  _packetLength = 0;
+
+  return 1;
+}
+
+int LoRaCompressor::endPacket(bool async)
+{
+  uint8_t frame[LORA_COMPRESS_MAX_PAYLOAD];
+  size_t length = encode(_packet, _packetLength, frame, sizeof(frame));
+
+  _packetLength = 0;
+
+  if (!length || !_radio.beginPacket()) {
+    return 0;
+  }
+  _radio.write(frame, length);
+
+  return _radio.endPacket(async);
+}
+
+size_t LoRaCompressor::write(uint8_t byte)
+{
+  return write(&byte, sizeof(byte));
+}
+
+size_t LoRaCompressor::write(const uint8_t *buffer, size_t size)
+{
+  // like the radio's FIFO, whatever does not fit is cut
+  if (size > LORA_COMPRESS_MAX_PAYLOAD - _packetLength) {
+    size = LORA_COMPRESS_MAX_PAYLOAD - _packetLength;
+  }
+
+  memcpy(_packet + _packetLength, buffer, size);
+  _packetLength += size;
+
+  return size;
+}
+
+int LoRaCompressor::enqueue(const uint8_t *buffer, size_t size)
+{
+  uint8_t *slot = _radio.reserveTx();
+
+  if (!slot) {
+    return 0;
+  }
+
+  size_t length = encode(buffer, size, slot, LORA_TX_FIFO_SIZE);
+
+  return length ? _radio.commitTx(length) : 0;
+}
+
+size_t LoRaCompressor::encode(const uint8_t *buffer, size_t size, uint8_t *frame, size_t capacity)
+{
+  bool marked = size > 0 && buffer[0] == LORA_COMPRESS_MARKER;
+  size_t length = compress(buffer, size, frame, capacity);
+
+  _stats.frames++;
+  _stats.bytesIn += size;
+
+  if (length && (length < size || marked)) {
+    _stats.compressed++;
+    _stats.bytesOut += length;
+    return length;
+  }
+
+  // a plain frame starting with the marker would be taken for a compressed one
+  if (marked || size > capacity) {
+    return 0;
+  }
+
+  memcpy(frame, buffer, size);
+  _stats.bytesOut += size;
+
+  return size;
+}
+
+int LoRaCompressor::decode(const uint8_t *frame, size_t size, uint8_t *buffer, size_t capacity)
+{
+  if (size == 0 || frame[0] != LORA_COMPRESS_MARKER) {
+    if (size > capacity) {
+      return -1;
+    }
+    memcpy(buffer, frame, size);
+    return size;
+  }
+
+  if (size < COMPRESS_HEADER_SIZE) {
+    return -1;
+  }
+
+  size_t length = frame[1];
+  size_t in = COMPRESS_HEADER_SIZE;
+  size_t out = 0;
+
+  if (length == 0 || length > capacity) {
+    return -1;
+  }
+
+  while (out < length) {
+    if (in >= size) {
+      return -1;
+    }
+
+    uint8_t flags = frame[in++];
+
+    for (int bit = 0; bit < 8 && out < length; bit++) {
+      if (!(flags & (1 << bit))) {
+        if (in >= size) {
+          return -1;
+        }
+        buffer[out++] = frame[in++];
+        continue;
+      }
+
+      if (size - in < 2) {
+        return -1;
+      }
+
+      uint16_t token = (frame[in] << 8) | frame[in + 1];
+      size_t offset = (token >> 6) + 1;
+      size_t count = (token & 0x3f) + LORA_COMPRESS_MIN_MATCH;
+
+      in += 2;
+      if (offset > out + _dictionarySize || count > length - out) {
+        return -1;
+      }
+
+      // byte by byte: the source may overlap the output or start in the dictionary
+      for (size_t i = 0; i < count; i++, out++) {
+        buffer[out] = offset <= out ? buffer[out - offset] : _history[_dictionarySize + out - offset];
+      }
+    }
+  }
+
+  // trailing bytes mean the frame is not what we think it is
+  return in == size ? (int)length : -1;
+}
+
+size_t LoRaCompressor::compress(const uint8_t *buffer, size_t size, uint8_t *frame, size_t capacity)
+{
+  if (size == 0 || size > LORA_COMPRESS_MAX_PAYLOAD || capacity < COMPRESS_HEADER_SIZE) {
+    return 0;
+  }
+
+  size_t end = _dictionarySize + size;
+  size_t out = COMPRESS_HEADER_SIZE;
+  size_t flags = 0;
+  int bit = 8;
+
+  memcpy(_history + _dictionarySize, buffer, size);
+  memcpy(_head, _dictionaryHead, sizeof(_head));
+
+  // dictionary positions whose 3 bytes run into the frame
+  for (size_t i = _dictionarySize >= 2 ? _dictionarySize - 2 : 0; i < _dictionarySize; i++) {
+    if (i + LORA_COMPRESS_MIN_MATCH <= end) {
+      insert(i);
+    }
+  }
+
+  frame[0] = LORA_COMPRESS_MARKER;
+  frame[1] = size;
+
+  for (size_t pos = _dictionarySize; pos < end; bit++) {
+    if (bit == 8) {
+      if (out >= capacity) {
+        return 0;
+      }
+      flags = out++;
+      frame[flags] = 0;
+      bit = 0;
+    }
+
+    size_t bestLength = 0;
+    size_t bestOffset = 0;
+
+    if (end - pos >= LORA_COMPRESS_MIN_MATCH) {
+      size_t maxLength = end - pos < LORA_COMPRESS_MAX_MATCH ? end - pos : LORA_COMPRESS_MAX_MATCH;
+      int16_t candidate = _head[hash3(_history + pos)];
+
+      for (int chain = 0; candidate >= 0 && chain < LORA_COMPRESS_MAX_CHAIN; chain++) {
+        // cheap reject: a longer match must differ from the best one's end
+        if (_history[candidate + bestLength] == _history[pos + bestLength]) {
+          size_t length = 0;
+
+          while (length < maxLength && _history[candidate + length] == _history[pos + length]) {
+            length++;
+          }
+          if (length > bestLength) {
+            bestLength = length;
+            bestOffset = pos - candidate;
+            if (length == maxLength) {
+              break;
+            }
+          }
+        }
+        candidate = _prev[candidate];
+      }
+    }
+
+    if (bestLength >= LORA_COMPRESS_MIN_MATCH) {
+      uint16_t token = ((bestOffset - 1) << 6) | (bestLength - LORA_COMPRESS_MIN_MATCH);
+
+      if (capacity - out < 2) {
+        return 0;
+      }
+      frame[flags] |= 1 << bit;
+      frame[out++] = token >> 8;
+      frame[out++] = token & 0xff;
+
+      for (size_t i = 0; i < bestLength; i++, pos++) {
+        if (pos + LORA_COMPRESS_MIN_MATCH <= end) {
+          insert(pos);
+        }
+      }
+    } else {
+      if (out >= capacity) {
+        return 0;
+      }
+      frame[out++] = _history[pos];
+
+      if (pos + LORA_COMPRESS_MIN_MATCH <= end) {
+        insert(pos);
+      }
+      pos++;
+    }
+  }
+
+  return out;
+}
+
+void LoRaCompressor::insert(size_t position)
+{
+  uint8_t h = hash3(_history + position);
+
+  _prev[position] = _head[h];
+  _head[h] = position;
+}
@@ -0,0 +1,82 @@
+#ifndef LORA_COMPRESS_H
+#define LORA_COMPRESS_H
+
+#include "Lora-RP2040.h"
+
+// first byte of a compressed frame; plain frames never start with it, the
+// sender compresses those whatever the gain so receivers can tell them apart
+#define LORA_COMPRESS_MARKER          0xc5
+
+#define LORA_COMPRESS_MAX_PAYLOAD     255
+#define LORA_COMPRESS_MAX_DICTIONARY  256
+
+// LZSS tokens: a flag byte for every 8 items, literals as they are and
+// matches as 10-bit offset / 6-bit length pairs
+#define LORA_COMPRESS_MIN_MATCH       3
+#define LORA_COMPRESS_MAX_MATCH       (LORA_COMPRESS_MIN_MATCH + 63)
+#define LORA_COMPRESS_HASH_BITS       8
+#define LORA_COMPRESS_MAX_CHAIN       16
+
+struct LoRaCompressStats {
+  uint32_t frames;
+  uint32_t compressed; // frames that went out compressed
+  uint32_t bytesIn;
+  uint32_t bytesOut;
+};
+
+// Optional compression between the application and the radio. The window
+// is the frame itself, after an optional pre-shared dictionary that both
+// ends load with setDictionary(); everything is static, about 3 KB.
+//
+// As a Print it stands in for LoRa between beginPacket() and endPacket():
+// the payload is buffered, compressed at endPacket() and sent only if that
+// makes it shorter. decode() passes plain frames through, so nodes with and
+// without the layer share a channel.
+class LoRaCompressor : public Print {
+public:
+  LoRaCompressor(LoRaClass &radio = LoRa);
+
+  // same bytes on both ends, NULL or 0 for none; only the last
+  // LORA_COMPRESS_MAX_DICTIONARY bytes are kept
+  void setDictionary(const uint8_t *dictionary, size_t size);
+
+  int beginPacket();
+  int endPacket(bool async = false);
+  virtual size_t write(uint8_t byte);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+
+  // straight into the radio's TX queue slot, 0 if the queue is full
+  int enqueue(const uint8_t *buffer, size_t size);
+
+  // returns the frame length, 0 if it does not fit in capacity
+  size_t encode(const uint8_t *buffer, size_t size, uint8_t *frame, size_t capacity);
+  // returns the payload length, -1 for a malformed compressed frame or one
+  // that does not fit; plain frames are copied as they are
+  int decode(const uint8_t *frame, size_t size, uint8_t *buffer, size_t capacity);
+
+  const LoRaCompressStats &stats() { return _stats; }
+
+private:
+  size_t compress(const uint8_t *buffer, size_t size, uint8_t *frame, size_t capacity);
+  void insert(size_t position);
+
+private:
+  LoRaClass &_radio;
+  LoRaCompressStats _stats;
+
+  uint8_t _packet[LORA_COMPRESS_MAX_PAYLOAD];
+  size_t _packetLength;
+
+  // dictionary, then the frame being compressed
+  uint8_t _history[LORA_COMPRESS_MAX_DICTIONARY + LORA_COMPRESS_MAX_PAYLOAD];
+  size_t _dictionarySize;
+
+  // hash chains over _history, -1 ends a chain; _dictionaryHead is the
+  // state after the dictionary, restored for every frame
+  int16_t _head[1 << LORA_COMPRESS_HASH_BITS];
+  int16_t _dictionaryHead[1 << LORA_COMPRESS_HASH_BITS];
+  int16_t _prev[LORA_COMPRESS_MAX_DICTIONARY + LORA_COMPRESS_MAX_PAYLOAD];
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "LoRa-DutyCycle.h"
+
+// tokens are kept in microseconds times 10000 so every duty cycle, down to
+// 0.01%, refills by a whole number per microsecond
+#define TOKEN_SCALE 10000
+
+const LoRaSubBand LORA_EU868_SUB_BANDS[] = {
+  { 863000000, 865000000, 10 },   // 0.1%
+  { 865000000, 868000000, 100 },  // 1%
+  { 868000000, 868600000, 100 },  // 1%
+  { 868700000, 869200000, 10 },   // 0.1%
+  { 869400000, 869650000, 1000 }, // 10%
+  { 869700000, 870000000, 100 },  // 1%
+};
+
+LoRaDutyCycle::LoRaDutyCycle() :
+  _count(0),
+  _periodUs(0)
+{
+}
+
+void LoRaDutyCycle::begin(const LoRaSubBand *subBands, size_t count, uint32_t periodSeconds)
+{
+  if (count > LORA_DUTY_CYCLE_MAX_SUB_BANDS) {
+    count = LORA_DUTY_CYCLE_MAX_SUB_BANDS;
+  }
+
+  _periodUs = (uint64_t)periodSeconds * 1000000;
+
+  for (size_t i = 0; i < count; i++) {
+    _subBands[i] = subBands[i];
+
+    // nothing was sent in the last period, start with the full budget
+    _buckets[i].tokens = _periodUs * _subBands[i].dutyCycle;
+    _buckets[i].updated = 0;
+  }
+
+  _count = count;
+}
+
+void LoRaDutyCycle::end()
+{
+  _count = 0;
+}
+
+int LoRaDutyCycle::find(long frequency)
+{
+  for (size_t i = 0; i < _count; i++) {
+    if (frequency >= _subBands[i].minFrequency && frequency < _subBands[i].maxFrequency) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+void LoRaDutyCycle::refill(int index, uint64_t now)
+{
+  Bucket &bucket = _buckets[index];
+  uint64_t capacity = _periodUs * _subBands[index].dutyCycle;
+
+  if (now > bucket.updated) {
+    bucket.tokens += (now - bucket.updated) * _subBands[index].dutyCycle;
+
+    if (bucket.tokens > capacity) {
+      bucket.tokens = capacity;
+    }
+  }
+
+  bucket.updated = now;
+}
+
+bool LoRaDutyCycle::canSend(long frequency, uint32_t airtimeUs, uint64_t now)
+{
+  int index = find(frequency);
+
+  if (index < 0) {
+    return true;
+  }
+
+  refill(index, now);
+
+  return _buckets[index].tokens >= (uint64_t)airtimeUs * TOKEN_SCALE;
+}
+
+uint64_t LoRaDutyCycle::nextSendTime(long frequency, uint32_t airtimeUs, uint64_t now)
+{
+  int index = find(frequency);
+
+  if (index < 0) {
+    return now;
+  }
+
+  refill(index, now);
+
+  uint64_t cost = (uint64_t)airtimeUs * TOKEN_SCALE;
+  uint64_t tokens = _buckets[index].tokens;
+
+  if (tokens >= cost) {
+    return now;
+  }
+
+  if (cost > _periodUs * _subBands[index].dutyCycle) {
+    // longer than a whole period's budget, or a band closed to
+    // transmission (dutyCycle 0), it will never fit
+    return UINT64_MAX;
+  }
+
+  // round up, the frame must fit entirely
+  uint16_t rate = _subBands[index].dutyCycle;
+
+  return now + (cost - tokens + rate - 1) / rate;
+}
+
+void LoRaDutyCycle::charge(long frequency, uint32_t airtimeUs, uint64_t now)
+{
+  int index = find(frequency);
+
+  if (index < 0) {
+    return;
+  }
+
+  refill(index, now);
+
+  uint64_t cost = (uint64_t)airtimeUs * TOKEN_SCALE;
+  Bucket &bucket = _buckets[index];
+
+  bucket.tokens = bucket.tokens > cost ? bucket.tokens - cost : 0;
+}
+
+uint32_t LoRaDutyCycle::available(long frequency, uint64_t now)
+{
+  int index = find(frequency);
+
+  if (index < 0) {
+    return UINT32_MAX;
+  }
+
+  refill(index, now);
+
+  return _buckets[index].tokens / TOKEN_SCALE;
+}
@@ -0,0 +1,57 @@
+#ifndef LORA_DUTY_CYCLE_H
+#define LORA_DUTY_CYCLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LORA_DUTY_CYCLE_MAX_SUB_BANDS 8
+
+// A regulated frequency range and the share of time a node may transmit in
+// it, in hundredths of a percent (100 = 1%)
+struct LoRaSubBand {
+  long minFrequency;
+  long maxFrequency;
+  uint16_t dutyCycle;
+};
+
+// ETSI EN 300 220 sub-bands used by EU868 nodes
+extern const LoRaSubBand LORA_EU868_SUB_BANDS[];
+#define LORA_EU868_SUB_BAND_COUNT 6
+
+// Airtime accounting, one token bucket per sub-band. A bucket refills at the
+// duty cycle rate and holds at most one period worth of airtime, so a node
+// can spend its whole hourly budget in a burst and never more. Frequencies
+// outside every sub-band are not limited. Times are time_us_64() values.
+class LoRaDutyCycle {
+public:
+  LoRaDutyCycle();
+
+  void begin(const LoRaSubBand *subBands, size_t count, uint32_t periodSeconds = 3600);
+  void end();
+  bool enabled() { return _count > 0; }
+
+  bool canSend(long frequency, uint32_t airtimeUs, uint64_t now);
+  // UINT64_MAX if never, e.g. in a sub-band with dutyCycle 0; now outside
+  // every sub-band
+  uint64_t nextSendTime(long frequency, uint32_t airtimeUs, uint64_t now);
+  void charge(long frequency, uint32_t airtimeUs, uint64_t now);
+
+  // airtime left right now, UINT32_MAX outside the regulated sub-bands
+  uint32_t available(long frequency, uint64_t now);
+
+private:
+  struct Bucket {
+    uint64_t tokens;   // airtime in microseconds, times 10000
+    uint64_t updated;
+  };
+
+  int find(long frequency);
+  void refill(int index, uint64_t now);
+
+  LoRaSubBand _subBands[LORA_DUTY_CYCLE_MAX_SUB_BANDS];
+  Bucket _buckets[LORA_DUTY_CYCLE_MAX_SUB_BANDS];
+  size_t _count;
+  uint64_t _periodUs;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "LoRa-Engine.h"
+
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+LoRaEngine *LoRaEngine::_active = NULL;
+
+LoRaEngine::LoRaEngine(LoRaClass &radio) :
+  _radio(radio),
+  _running(false),
+  _stopRequested(false),
+  _transmitting(false),
+  _receiving(false),
+  _txDropped(0),
+  _rxDropped(0),
+  _eventsDropped(0)
+{
+}
+
+int LoRaEngine::start()
+{
+  if (_active) {
+    return 0;
+  }
+
+  _active = this;
+  _stopRequested = false;
+  _running = true;
+
+  multicore_launch_core1(&LoRaEngine::core1Entry);
+
+  return 1;
+}
+
+void LoRaEngine::stop()
+{
+  if (_active != this) {
+    return;
+  }
+
+  _stopRequested = true;
+  __sev();
+
+  while (_running) {
+    tight_loop_contents();
+  }
+
+  multicore_reset_core1();
+  _active = NULL;
+}
+
+bool LoRaEngine::send(const uint8_t *buffer, size_t size)
+{
+  LoRaEngineFrame *frame = _txQueue.reserve();
+
+  if (!frame || size > LORA_ENGINE_MAX_FRAME) {
+    _txDropped = _txDropped + 1;
+    return false;
+  }
+
+  frame->length = size;
+  memcpy(frame->data, buffer, size);
+  _txQueue.commit();
+
+  // wake core1 if it is waiting for work
+  __sev();
+
+  return true;
+}
+
+bool LoRaEngine::receive(LoRaEngineFrame &frame)
+{
+  return _rxQueue.pop(frame);
+}
+
+bool LoRaEngine::pollEvent(LoRaEngineEvent &event)
+{
+  return _events.pop(event);
+}
+
+void LoRaEngine::core1Entry()
+{
+  _active->run();
+}
+
+void LoRaEngine::run()
+{
+  // the DIO0 interrupt is enabled on the core that registers the callbacks,
+  // and runs deferred so the radio is only touched from this loop
+  _radio.setDeferredIrq(true);
+  _radio.onReceive(&LoRaEngine::onRadioReceive);
+  _radio.onTxDone(&LoRaEngine::onRadioTxDone);
+  _transmitting = false;
+  _receiving = false;
+
+  while (!_stopRequested) {
+    bool busy = _radio.poll() > 0;
+
+    if (!_transmitting) {
+      LoRaEngineFrame *frame = _txQueue.peek();
+
+      if (frame) {
+        _radio.beginPacket();
+        _radio.write(frame->data, frame->length);
+        _radio.endPacket(true);
+        _txQueue.discard();
+
+        _transmitting = true;
+        _receiving = false;
+        busy = true;
+      } else if (!_receiving) {
+        _radio.receive();
+        _receiving = true;
+      }
+    }
+
+    if (!busy) {
+      // DIO0 or a send() from core0 wakes us up
+      __wfe();
+    }
+  }
+
+  _radio.onReceive(NULL);
+  _radio.onTxDone(NULL);
+  _radio.setDeferredIrq(false);
+  _radio.idle();
+
+  _running = false;
+}
+
+void LoRaEngine::pushEvent(uint8_t type, uint8_t length, uint64_t timestamp)
+{
+  LoRaEngineEvent event = { type, length, timestamp };
+
+  if (!_events.push(event)) {
+    _eventsDropped = _eventsDropped + 1;
+  }
+}
+
+void LoRaEngine::handleReceive(int packetSize)
+{
+  LoRaEngineFrame *frame = _rxQueue.reserve();
+
+  if (!frame) {
+    _rxDropped = _rxDropped + 1;
+    pushEvent(LORA_EVENT_RX_DROPPED, packetSize, _radio.irqTime());
+    return;
+  }
+
+  const PacketInfo &info = _radio.packetInfo();
+
+  frame->length = _radio.readPacket(frame->data, sizeof(frame->data));
+  frame->rssi = info.rssi;
+  frame->snr = info.snr;
+  frame->timestamp = info.timestamp;
+  _rxQueue.commit();
+
+  pushEvent(LORA_EVENT_RX_DONE, frame->length, frame->timestamp);
+}
+
+void LoRaEngine::onRadioReceive(int packetSize)
+{
+  _active->handleReceive(packetSize);
+}
+
+void LoRaEngine::onRadioTxDone()
+{
+  _active->_transmitting = false;
+  _active->pushEvent(LORA_EVENT_TX_DONE, 0, _active->_radio.irqTime());
+}
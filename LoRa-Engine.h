@@ -0,0 +1,86 @@
+#ifndef LORA_ENGINE_H
+#define LORA_ENGINE_H
+
+#include "Lora-RP2040.h"
+#include "LoRa-Queue.h"
+
+#define LORA_ENGINE_TX_QUEUE_SIZE    8
+#define LORA_ENGINE_RX_QUEUE_SIZE    8
+#define LORA_ENGINE_EVENT_QUEUE_SIZE 16
+
+#define LORA_ENGINE_MAX_FRAME        255
+
+enum LoRaEngineEventType {
+  LORA_EVENT_TX_DONE,
+  LORA_EVENT_RX_DONE,
+  LORA_EVENT_RX_DROPPED   // RX queue was full, the frame stayed in the radio
+};
+
+struct LoRaEngineFrame {
+  uint8_t length;
+  uint8_t data[LORA_ENGINE_MAX_FRAME];
+  int rssi;              // only filled for received frames
+  float snr;
+  uint64_t timestamp;    // time_us_64() of the RxDone edge
+};
+
+struct LoRaEngineEvent {
+  uint8_t type;          // LoRaEngineEventType
+  uint8_t length;
+  uint64_t timestamp;
+};
+
+// Runs a LoRaClass on core1. Configure the radio on core0 (begin(),
+// frequency, SF...) and call start(); from then on core0 only talks to the
+// engine through the queues below and must not touch the radio directly.
+class LoRaEngine {
+public:
+  LoRaEngine(LoRaClass &radio = LoRa);
+
+  int start();
+  void stop();
+  bool running() { return _running; }
+
+  // core0 side, none of these block or touch SPI
+  bool send(const uint8_t *buffer, size_t size);
+  bool receive(LoRaEngineFrame &frame);
+  bool pollEvent(LoRaEngineEvent &event);
+
+  size_t txDepth() { return _txQueue.size(); }
+  size_t rxDepth() { return _rxQueue.size(); }
+  size_t eventDepth() { return _events.size(); }
+
+  uint32_t txDropped() { return _txDropped; }
+  uint32_t rxDropped() { return _rxDropped; }
+  uint32_t eventsDropped() { return _eventsDropped; }
+
+private:
+  void run();
+  void pushEvent(uint8_t type, uint8_t length, uint64_t timestamp);
+  void handleReceive(int packetSize);
+
+  static void core1Entry();
+  static void onRadioReceive(int packetSize);
+  static void onRadioTxDone();
+
+private:
+  LoRaClass &_radio;
+  volatile bool _running;
+  volatile bool _stopRequested;
+  bool _transmitting;
+  bool _receiving;
+
+  SpscQueue<LoRaEngineFrame, LORA_ENGINE_TX_QUEUE_SIZE> _txQueue;
+  SpscQueue<LoRaEngineFrame, LORA_ENGINE_RX_QUEUE_SIZE> _rxQueue;
+  SpscQueue<LoRaEngineEvent, LORA_ENGINE_EVENT_QUEUE_SIZE> _events;
+
+  // each counter has a single writer: TX on core0, the others on core1
+  volatile uint32_t _txDropped;
+  volatile uint32_t _rxDropped;
+  volatile uint32_t _eventsDropped;
+
+  // there is only one core1, so only one engine can run at a time
+  static LoRaEngine *_active;
+};
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef LORA_FRAME_H
+#define LORA_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits>
+#include <type_traits>
+
+// Binary framing without allocation: a bit-packed header, then fields in
+// little endian or as varints, written into any buffer (LoRa.reserveTx()
+// hands out the TX queue slot itself) and read back through bounds-checked
+// views of the received frame. Layouts are constexpr, so the largest frame
+// and its airtime are known at compile time.
+
+// header: destination, source, flags and sequence packed MSB first into as
+// few bytes as the layout needs, at most 32 bits
+struct LoRaHeaderLayout {
+  uint8_t addressBits;
+  uint8_t flagBits;
+  uint8_t sequenceBits;
+
+  constexpr size_t bits() const { return 2 * addressBits + flagBits + sequenceBits; }
+  constexpr size_t size() const { return (bits() + 7) / 8; }
+
+  // the all-ones address
+  constexpr uint8_t broadcast() const { return (uint8_t)((1u << addressBits) - 1); }
+};
+
+// 16 nodes, 2 flags and 64 sequence numbers in two bytes
+constexpr LoRaHeaderLayout LORA_HEADER_SHORT = { 4, 2, 6 };
+// 8-bit addresses, 4 flags and 4096 sequence numbers in four bytes
+constexpr LoRaHeaderLayout LORA_HEADER_LONG = { 8, 4, 12 };
+
+static_assert(LORA_HEADER_SHORT.size() == 2 && LORA_HEADER_LONG.size() == 4, "header sizes");
+
+struct LoRaHeader {
+  uint8_t destination;
+  uint8_t source;
+  uint8_t flags;
+  uint16_t sequence;
+};
+
+// Read-only window on received bytes; out-of-range access gives an empty
+// view or 0, never a read past the frame.
+class LoRaView {
+public:
+  LoRaView() : _data(NULL), _size(0) {}
+  LoRaView(const uint8_t *data, size_t size) : _data(data), _size(size) {}
+
+  const uint8_t *data() const { return _data; }
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  uint8_t operator[](size_t i) const { return i < _size ? _data[i] : 0; }
+
+  LoRaView sub(size_t offset, size_t size) const
+  {
+    if (offset > _size || size > _size - offset) {
+      return LoRaView();
+    }
+    return LoRaView(_data + offset, size);
+  }
+
+private:
+  const uint8_t *_data;
+  size_t _size;
+};
+
+// Appends to a caller's buffer. Running out of room is sticky: later writes
+// are dropped and ok() stays false, so a frame is checked once at the end.
+class LoRaFrameWriter {
+public:
+  LoRaFrameWriter(uint8_t *buffer, size_t capacity) :
+    _buffer(buffer), _capacity(capacity), _length(0), _overflow(false) {}
+
+  bool ok() const { return !_overflow; }
+  size_t length() const { return _length; }
+  const uint8_t *data() const { return _buffer; }
+
+  void header(const LoRaHeaderLayout &layout, const LoRaHeader &header)
+  {
+    uint32_t packed = field(0, header.destination, layout.addressBits);
+
+    packed = field(packed, header.source, layout.addressBits);
+    packed = field(packed, header.flags, layout.flagBits);
+    packed = field(packed, header.sequence, layout.sequenceBits);
+
+    // left-aligned, MSB first
+    packed <<= layout.size() * 8 - layout.bits();
+    for (size_t i = layout.size(); i > 0; i--) {
+      u8(packed >> ((i - 1) * 8));
+    }
+  }
+
+  void u8(uint8_t value)
+  {
+    if (room(1)) {
+      _buffer[_length++] = value;
+    }
+  }
+
+  // fixed width, little endian
+  template <typename T>
+  void le(T value)
+  {
+    static_assert(std::is_integral<T>::value, "le() takes integers");
+    typename std::make_unsigned<T>::type bits = value;
+
+    if (room(sizeof(T))) {
+      for (size_t i = 0; i < sizeof(T); i++) {
+        _buffer[_length++] = bits >> (8 * i);
+      }
+    }
+  }
+
+  // LEB128, 7 bits per byte; signed values are zigzag encoded first so
+  // small negative numbers stay short
+  template <typename T>
+  void varint(T value)
+  {
+    static_assert(std::is_integral<T>::value, "varint() takes integers");
+    uint64_t bits = std::is_signed<T>::value ?
+                    ((uint64_t)(int64_t)value << 1) ^ (uint64_t)((int64_t)value >> 63) :
+                    (uint64_t)value;
+
+    do {
+      uint8_t byte = bits & 0x7f;
+
+      bits >>= 7;
+      u8(bits ? byte | 0x80 : byte);
+    } while (bits);
+  }
+
+  void bytes(const void *data, size_t size)
+  {
+    if (room(size)) {
+      memcpy(_buffer + _length, data, size);
+      _length += size;
+    }
+  }
+
+private:
+  static uint32_t field(uint32_t packed, uint32_t value, uint8_t bits)
+  {
+    return bits ? (packed << bits) | (value & ((1u << bits) - 1)) : packed;
+  }
+
+  bool room(size_t size)
+  {
+    if (_overflow || size > _capacity - _length) {
+      _overflow = true;
+      return false;
+    }
+    return true;
+  }
+
+  uint8_t *_buffer;
+  size_t _capacity;
+  size_t _length;
+  bool _overflow;
+};
+
+// Reads a received frame in place. Every read checks the bounds; the first
+// one that fails returns false and makes ok() false for good.
+class LoRaFrameReader {
+public:
+  LoRaFrameReader(const uint8_t *data, size_t length) :
+    _data(data), _length(length), _offset(0), _error(false) {}
+  explicit LoRaFrameReader(const LoRaView &view) :
+    LoRaFrameReader(view.data(), view.size()) {}
+
+  bool ok() const { return !_error; }
+  size_t remaining() const { return _length - _offset; }
+
+  bool header(const LoRaHeaderLayout &layout, LoRaHeader &header)
+  {
+    uint32_t packed = 0;
+
+    if (!take(layout.size())) {
+      return false;
+    }
+    for (size_t i = 0; i < layout.size(); i++) {
+      packed = (packed << 8) | _data[_offset - layout.size() + i];
+    }
+
+    packed >>= layout.size() * 8 - layout.bits();
+    header.sequence = field(packed, layout.sequenceBits);
+    header.flags = field(packed, layout.flagBits);
+    header.source = field(packed, layout.addressBits);
+    header.destination = field(packed, layout.addressBits);
+
+    return true;
+  }
+
+  bool u8(uint8_t &value)
+  {
+    if (!take(1)) {
+      return false;
+    }
+    value = _data[_offset - 1];
+    return true;
+  }
+
+  template <typename T>
+  bool le(T &value)
+  {
+    static_assert(std::is_integral<T>::value, "le() takes integers");
+    typename std::make_unsigned<T>::type bits = 0;
+
+    if (!take(sizeof(T))) {
+      return false;
+    }
+    for (size_t i = 0; i < sizeof(T); i++) {
+      bits |= (typename std::make_unsigned<T>::type)_data[_offset - sizeof(T) + i] << (8 * i);
+    }
+    value = (T)bits;
+    return true;
+  }
+
+  // rejects encodings longer than T allows and values that do not fit in it
+  template <typename T>
+  bool varint(T &value)
+  {
+    static_assert(std::is_integral<T>::value, "varint() takes integers");
+    uint64_t bits = 0;
+
+    for (unsigned shift = 0; ; shift += 7) {
+      uint8_t byte;
+
+      if (shift >= LoRaFrameReader::maxVarint<T>() * 7 || !u8(byte)) {
+        _error = true;
+        return false;
+      }
+      bits |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+
+    if (std::is_signed<T>::value) {
+      int64_t decoded = (int64_t)((bits >> 1) ^ (0 - (bits & 1)));
+
+      if (decoded < (int64_t)std::numeric_limits<T>::min() ||
+          decoded > (int64_t)std::numeric_limits<T>::max()) {
+        _error = true;
+        return false;
+      }
+      value = (T)decoded;
+      return true;
+    }
+
+    if (bits > (uint64_t)std::numeric_limits<T>::max()) {
+      _error = true;
+      return false;
+    }
+    value = (T)bits;
+    return true;
+  }
+
+  // zero-copy: points into the frame, valid while the frame is
+  bool view(size_t size, LoRaView &view)
+  {
+    if (!take(size)) {
+      view = LoRaView();
+      return false;
+    }
+    view = LoRaView(_data + _offset - size, size);
+    return true;
+  }
+
+  LoRaView rest()
+  {
+    LoRaView view(_data + _offset, remaining());
+
+    _offset = _length;
+    return view;
+  }
+
+  // longest LEB128 encoding of a T
+  template <typename T>
+  static constexpr size_t maxVarint() { return (sizeof(T) * 8 + 6) / 7; }
+
+private:
+  uint32_t field(uint32_t &packed, uint8_t bits)
+  {
+    uint32_t value = bits ? packed & ((1u << bits) - 1) : 0;
+
+    packed = bits ? packed >> bits : packed;
+    return value;
+  }
+
+  bool take(size_t size)
+  {
+    if (_error || size > _length - _offset) {
+      _error = true;
+      return false;
+    }
+    _offset += size;
+    return true;
+  }
+
+  const uint8_t *_data;
+  size_t _length;
+  size_t _offset;
+  bool _error;
+};
+
+// Field kinds for message layouts
+template <typename T>
+struct LoRaLe {
+  typedef T type;
+  static constexpr size_t maxSize = sizeof(T);
+
+  static void write(LoRaFrameWriter &writer, T value) { writer.le(value); }
+  static bool read(LoRaFrameReader &reader, T &value) { return reader.le(value); }
+};
+
+template <typename T>
+struct LoRaVarint {
+  typedef T type;
+  static constexpr size_t maxSize = LoRaFrameReader::maxVarint<T>();
+
+  static void write(LoRaFrameWriter &writer, T value) { writer.varint(value); }
+  static bool read(LoRaFrameReader &reader, T &value) { return reader.varint(value); }
+};
+
+// A message as a list of fields, e.g.
+//   typedef LoRaMessage<LoRaVarint<uint32_t>, LoRaVarint<int16_t>, LoRaLe<uint16_t>> Telemetry;
+// maxSize bounds the encoded length at compile time.
+template <typename... Fields>
+struct LoRaMessage {
+  static constexpr size_t maxSize = (Fields::maxSize + ... + 0);
+
+  static bool write(LoRaFrameWriter &writer, const typename Fields::type &... values)
+  {
+    (Fields::write(writer, values), ...);
+    return writer.ok();
+  }
+
+  static bool read(LoRaFrameReader &reader, typename Fields::type &... values)
+  {
+    return (Fields::read(reader, values) && ...);
+  }
+};
+
+#endif
@@ -0,0 +1,465 @@
+#include "LoRa-Link.h"
+
+// frame types, first byte of every frame
+#define LINK_DATA      0xe0
+#define LINK_DATA_ASK  0xe1 // last frame of a burst, answer with an ACK
+#define LINK_ACK       0xea
+
+// ACK: type, destination, source, next sequence expected (LE), bitmap of
+// the frames held past it (bit 0 is next + 1)
+#define LINK_ACK_SIZE  6
+
+// granularity the RTO never drops under, RFC 6298 G
+#define LINK_CLOCK_US  1000
+
+static int16_t seqDiff(uint16_t a, uint16_t b)
+{
+  return (int16_t)(a - b);
+}
+
+LoRaLink::LoRaLink(uint8_t address, LoRaClass &radio) :
+  _radio(radio),
+  _address(address),
+  _window(LORA_LINK_MAX_WINDOW),
+  _stats(),
+  _airFreeAt(0),
+  _onMessage(NULL),
+  _onDelivery(NULL)
+{
+  for (int i = 0; i < LORA_LINK_MAX_PEERS; i++) {
+    _peers[i].used = false;
+  }
+}
+
+void LoRaLink::begin()
+{
+  _airFreeAt = 0;
+  for (int i = 0; i < LORA_LINK_MAX_PEERS; i++) {
+    _peers[i].used = false;
+  }
+
+  _radio.enablePacketPool();
+
+  // the TX queue goes back to RX after each burst when it finds the radio receiving
+  _radio.receive();
+}
+
+void LoRaLink::end()
+{
+  _radio.disablePacketPool();
+}
+
+void LoRaLink::setWindow(uint8_t frames)
+{
+  if (frames < 1) {
+    frames = 1;
+  } else if (frames > LORA_LINK_MAX_WINDOW) {
+    frames = LORA_LINK_MAX_WINDOW;
+  }
+
+  _window = frames;
+}
+
+void LoRaLink::onMessage(void(*callback)(uint8_t, const uint8_t*, size_t))
+{
+  _onMessage = callback;
+}
+
+void LoRaLink::onDelivery(void(*callback)(uint8_t, uint16_t, bool))
+{
+  _onDelivery = callback;
+}
+
+int LoRaLink::send(uint8_t to, const uint8_t *buffer, size_t size)
+{
+  Peer *peer = findPeer(to, true);
+
+  if (!peer || size == 0 || size > LORA_LINK_PAYLOAD_SIZE ||
+      (uint16_t)(peer->txNext - peer->txBase) >= _window) {
+    return 0;
+  }
+
+  // sent from poll(), so messages handed over together leave as one burst
+  Slot &slot = peer->txSlots[peer->txNext % LORA_LINK_MAX_WINDOW];
+
+  slot.length = size;
+  slot.sent = false;
+  slot.acked = false;
+  slot.resend = false;
+  memcpy(slot.data, buffer, size);
+  peer->txNext++;
+
+  return 1;
+}
+
+size_t LoRaLink::pending(uint8_t to)
+{
+  Peer *peer = findPeer(to, false);
+
+  return peer ? (uint16_t)(peer->txNext - peer->txBase) : 0;
+}
+
+uint32_t LoRaLink::rtt(uint8_t peer)
+{
+  Peer *p = findPeer(peer, false);
+
+  return p ? p->srtt : 0;
+}
+
+uint32_t LoRaLink::rto(uint8_t peer)
+{
+  Peer *p = findPeer(peer, false);
+
+  return p ? p->rto : 0;
+}
+
+void LoRaLink::poll()
+{
+  // deferred IRQs and duty-cycle holds of the radio itself
+  _radio.poll();
+
+  while (PacketRef packet = _radio.takePacket()) {
+    handleFrame(packet.data(), packet.length());
+  }
+
+  for (int i = 0; i < LORA_LINK_MAX_PEERS; i++) {
+    if (_peers[i].used) {
+      servicePeer(_peers[i]);
+    }
+  }
+}
+
+LoRaLink::Peer *LoRaLink::findPeer(uint8_t address, bool create)
+{
+  Peer *free = NULL;
+
+  for (int i = 0; i < LORA_LINK_MAX_PEERS; i++) {
+    if (_peers[i].used && _peers[i].address == address) {
+      return &_peers[i];
+    }
+    if (!_peers[i].used && !free) {
+      free = &_peers[i];
+    }
+  }
+
+  if (create && free) {
+    resetPeer(*free, address);
+    return free;
+  }
+
+  return NULL;
+}
+
+void LoRaLink::resetPeer(Peer &peer, uint8_t address)
+{
+  memset(&peer, 0, sizeof(peer));
+  peer.used = true;
+  peer.address = address;
+
+  // no sample yet: the ACK's airtime plus the other side's turnaround
+  peer.rto = _radio.timeOnAir(LINK_ACK_SIZE) + LORA_LINK_INITIAL_RTO_US;
+}
+
+void LoRaLink::handleFrame(const uint8_t *frame, size_t length)
+{
+  if (length < 3 || frame[1] != _address) {
+    // too short, or not ours
+    return;
+  }
+
+  if (frame[0] == LINK_DATA || frame[0] == LINK_DATA_ASK) {
+    Peer *peer = findPeer(frame[2], true);
+
+    if (peer) {
+      handleData(*peer, frame, length);
+    }
+  } else if (frame[0] == LINK_ACK) {
+    Peer *peer = findPeer(frame[2], false);
+
+    if (peer) {
+      handleAck(*peer, frame, length);
+    }
+  }
+}
+
+void LoRaLink::handleData(Peer &peer, const uint8_t *frame, size_t length)
+{
+  if (length <= LORA_LINK_HEADER_SIZE) {
+    return;
+  }
+
+  uint16_t seq = frame[3] | (frame[4] << 8);
+  uint16_t base = seq - frame[5];
+
+  // the sender gave up on what came before its oldest frame, skip the holes
+  while (seqDiff(base, peer.rxNext) > 0) {
+    Slot &slot = peer.rxSlots[peer.rxNext % LORA_LINK_MAX_WINDOW];
+
+    if (slot.length) {
+      if (_onMessage) {
+        _onMessage(peer.address, slot.data, slot.length);
+      }
+      _stats.delivered++;
+    }
+    slot.length = 0;
+    peer.rxNext++;
+  }
+
+  int16_t offset = seqDiff(seq, peer.rxNext);
+  Slot &slot = peer.rxSlots[seq % LORA_LINK_MAX_WINDOW];
+
+  if (offset < 0 || (offset < LORA_LINK_MAX_WINDOW && slot.length)) {
+    // our ACK got lost, the answer to this one tells the sender again
+    _stats.duplicates++;
+  } else if (offset < LORA_LINK_MAX_WINDOW) {
+    slot.length = length - LORA_LINK_HEADER_SIZE;
+    memcpy(slot.data, frame + LORA_LINK_HEADER_SIZE, slot.length);
+  }
+
+  // hand over everything now in order
+  for (;;) {
+    Slot &next = peer.rxSlots[peer.rxNext % LORA_LINK_MAX_WINDOW];
+
+    if (!next.length) {
+      break;
+    }
+
+    if (_onMessage) {
+      _onMessage(peer.address, next.data, next.length);
+    }
+    _stats.delivered++;
+    next.length = 0;
+    peer.rxNext++;
+  }
+
+  if (frame[0] == LINK_DATA_ASK) {
+    sendAck(peer);
+  }
+}
+
+void LoRaLink::sendAck(Peer &peer)
+{
+  uint8_t frame[LINK_ACK_SIZE];
+  uint8_t bitmap = 0;
+
+  for (int i = 0; i < LORA_LINK_MAX_WINDOW - 1; i++) {
+    if (peer.rxSlots[(uint16_t)(peer.rxNext + 1 + i) % LORA_LINK_MAX_WINDOW].length) {
+      bitmap |= 1 << i;
+    }
+  }
+
+  frame[0] = LINK_ACK;
+  frame[1] = peer.address;
+  frame[2] = _address;
+  frame[3] = peer.rxNext & 0xff;
+  frame[4] = peer.rxNext >> 8;
+  frame[5] = bitmap;
+
+  if (enqueue(frame, sizeof(frame))) {
+    _stats.acksSent++;
+  }
+}
+
+void LoRaLink::handleAck(Peer &peer, const uint8_t *frame, size_t length)
+{
+  uint64_t now = time_us_64();
+
+  if (length < LINK_ACK_SIZE) {
+    return;
+  }
+
+  uint16_t next = frame[3] | (frame[4] << 8);
+  uint16_t inFlight = peer.txNext - peer.txBase;
+
+  if (seqDiff(next, peer.txBase) < 0 || (uint16_t)(next - peer.txBase) > inFlight) {
+    // older than what was already acked
+    return;
+  }
+
+  _stats.acksReceived++;
+
+  // cumulative part, then the selective one
+  for (uint16_t seq = peer.txBase; seq != next; seq++) {
+    peer.txSlots[seq % LORA_LINK_MAX_WINDOW].acked = true;
+  }
+  for (int i = 0; i < LORA_LINK_MAX_WINDOW - 1; i++) {
+    uint16_t seq = next + 1 + i;
+
+    if ((frame[5] & (1 << i)) && (uint16_t)(seq - peer.txBase) < inFlight) {
+      peer.txSlots[seq % LORA_LINK_MAX_WINDOW].acked = true;
+    }
+  }
+
+  if (peer.awaitingAck) {
+    // the answer to the burst: what it sent and the ACK does not list is lost
+    for (uint16_t seq = next; seqDiff(seq, peer.askSeq) <= 0; seq++) {
+      Slot &slot = peer.txSlots[seq % LORA_LINK_MAX_WINDOW];
+
+      slot.resend = slot.sent && !slot.acked;
+    }
+
+    if (!peer.askResent) {
+      sampleRtt(peer, now);
+    }
+    peer.awaitingAck = false;
+    peer.retries = 0;
+  }
+
+  releaseAcked(peer);
+}
+
+void LoRaLink::sampleRtt(Peer &peer, uint64_t now)
+{
+  // from the end of the frame that asked: the other side's turnaround and
+  // the ACK's airtime, whatever was queued in front of it does not count
+  uint32_t sample = now > peer.askEnd ? now - peer.askEnd : 0;
+
+  if (!peer.srtt) {
+    peer.srtt = sample;
+    peer.rttvar = sample / 2;
+  } else {
+    uint32_t error = peer.srtt > sample ? peer.srtt - sample : sample - peer.srtt;
+
+    peer.rttvar = (3 * peer.rttvar + error) / 4;
+    peer.srtt = (7 * peer.srtt + sample) / 8;
+  }
+
+  uint32_t rto = peer.srtt + (4 * peer.rttvar > LINK_CLOCK_US ? 4 * peer.rttvar : LINK_CLOCK_US);
+
+  if (rto < LORA_LINK_MIN_RTO_US) {
+    rto = LORA_LINK_MIN_RTO_US;
+  } else if (rto > LORA_LINK_MAX_RTO_US) {
+    rto = LORA_LINK_MAX_RTO_US;
+  }
+
+  peer.rto = rto;
+}
+
+void LoRaLink::releaseAcked(Peer &peer)
+{
+  while (peer.txBase != peer.txNext && peer.txSlots[peer.txBase % LORA_LINK_MAX_WINDOW].acked) {
+    if (_onDelivery) {
+      _onDelivery(peer.address, peer.txBase, true);
+    }
+    peer.txBase++;
+  }
+}
+
+void LoRaLink::servicePeer(Peer &peer)
+{
+  if (peer.awaitingAck) {
+    if (time_us_64() < peer.askEnd + peer.rto || _radio.txQueueDepth() != 0) {
+      return;
+    }
+
+    // the ACK, or the frame asking for it, got lost
+    _stats.timeouts++;
+    peer.awaitingAck = false;
+
+    if (++peer.retries >= LORA_LINK_MAX_RETRIES) {
+      // the peer is gone: give the window up, the next frame's base tells
+      // the receiver to skip it
+      while (peer.txBase != peer.txNext) {
+        if (_onDelivery) {
+          _onDelivery(peer.address, peer.txBase, false);
+        }
+        _stats.dropped++;
+        peer.txBase++;
+      }
+      peer.retries = 0;
+      return;
+    }
+
+    peer.rto = peer.rto * 2 < LORA_LINK_MAX_RTO_US ? peer.rto * 2 : LORA_LINK_MAX_RTO_US;
+
+    // ask again with the same frame, the answer lists the holes
+    Slot &ask = peer.txSlots[peer.askSeq % LORA_LINK_MAX_WINDOW];
+
+    if (!ask.acked && (uint16_t)(peer.askSeq - peer.txBase) < (uint16_t)(peer.txNext - peer.txBase)) {
+      ask.resend = true;
+    }
+  }
+
+  // a burst: the holes first, then new messages, the last one asks
+  uint16_t last = peer.txBase;
+  bool any = false;
+
+  for (uint16_t seq = peer.txBase; seq != peer.txNext; seq++) {
+    Slot &slot = peer.txSlots[seq % LORA_LINK_MAX_WINDOW];
+
+    if (!slot.acked && (!slot.sent || slot.resend)) {
+      last = seq;
+      any = true;
+    }
+  }
+
+  if (!any) {
+    return;
+  }
+
+  for (uint16_t seq = peer.txBase; seqDiff(seq, last) <= 0; seq++) {
+    Slot &slot = peer.txSlots[seq % LORA_LINK_MAX_WINDOW];
+
+    if (slot.acked || (slot.sent && !slot.resend)) {
+      continue;
+    }
+
+    if (_radio.txQueueDepth() >= LORA_TX_QUEUE_SIZE) {
+      // the rest waits for the next poll()
+      break;
+    }
+
+    sendSlot(peer, seq, seq == last);
+  }
+}
+
+void LoRaLink::sendSlot(Peer &peer, uint16_t seq, bool ask)
+{
+  Slot &slot = peer.txSlots[seq % LORA_LINK_MAX_WINDOW];
+  uint8_t frame[LORA_TX_FIFO_SIZE];
+
+  frame[0] = ask ? LINK_DATA_ASK : LINK_DATA;
+  frame[1] = peer.address;
+  frame[2] = _address;
+  frame[3] = seq & 0xff;
+  frame[4] = seq >> 8;
+  frame[5] = (uint8_t)(seq - peer.txBase);
+  memcpy(frame + LORA_LINK_HEADER_SIZE, slot.data, slot.length);
+
+  if (!enqueue(frame, LORA_LINK_HEADER_SIZE + slot.length)) {
+    return;
+  }
+
+  if (ask) {
+    peer.awaitingAck = true;
+    peer.askSeq = seq;
+    peer.askResent = slot.sent;
+    peer.askEnd = _airFreeAt;
+  }
+
+  if (slot.sent) {
+    _stats.retransmitted++;
+  } else {
+    _stats.sent++;
+  }
+
+  slot.sent = true;
+  slot.resend = false;
+}
+
+int LoRaLink::enqueue(const uint8_t *frame, size_t length)
+{
+  if (!_radio.enqueue(frame, length)) {
+    return 0;
+  }
+
+  // frames go out back to back from the TX queue
+  uint64_t now = time_us_64();
+
+  if (_airFreeAt < now) {
+    _airFreeAt = now;
+  }
+  _airFreeAt += _radio.timeOnAir(length);
+
+  return 1;
+}
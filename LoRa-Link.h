@@ -0,0 +1,133 @@
+#ifndef LORA_LINK_H
+#define LORA_LINK_H
+
+#include "Lora-RP2040.h"
+
+// type, destination, source, sequence (LE), distance back to the oldest
+// frame the sender still holds; a message plus its header fills the TX half
+// of the FIFO exactly
+#define LORA_LINK_HEADER_SIZE        6
+#define LORA_LINK_PAYLOAD_SIZE       (LORA_TX_FIFO_SIZE - LORA_LINK_HEADER_SIZE)
+
+// frames outstanding per peer; the selective ACK bitmap is one byte
+#define LORA_LINK_MAX_WINDOW         8
+#define LORA_LINK_MAX_PEERS          4
+
+// RTO before the first RTT sample, on top of the ACK's airtime
+#define LORA_LINK_INITIAL_RTO_US     100000
+#define LORA_LINK_MIN_RTO_US         5000
+#define LORA_LINK_MAX_RTO_US         4000000
+
+// RTOs in a row before the frames still in the window are given up
+#define LORA_LINK_MAX_RETRIES        6
+
+struct LoRaLinkStats {
+  uint32_t sent;          // first transmissions
+  uint32_t retransmitted;
+  uint32_t delivered;     // messages handed to onMessage, in order
+  uint32_t duplicates;    // frames received again after an ACK got lost
+  uint32_t acksSent;
+  uint32_t acksReceived;
+  uint32_t timeouts;      // RTOs that fired
+  uint32_t dropped;       // messages given up after LORA_LINK_MAX_RETRIES
+};
+
+// Reliable, in-order delivery of messages to a few peers. Each peer gets
+// 16-bit sequence numbers and a window of up to LORA_LINK_MAX_WINDOW frames
+// in flight; the last frame of a burst asks for an ACK, which carries the
+// next sequence expected (cumulative) and a bitmap of the frames received
+// past it (selective), so only the holes are sent again. The RTO is
+// smoothed from RTT samples (RFC 6298, Karn's rule) measured from the
+// estimated end of the frame on the air, so queued airtime never inflates it.
+//
+// Like LoRaTransfer, everything runs from poll(): frames leave through the
+// radio's TX queue and arrive through its packet pool, so the link owns the
+// radio between begin() and end(). Both ends must begin() together, sequence
+// numbers start at 0.
+class LoRaLink {
+public:
+  LoRaLink(uint8_t address, LoRaClass &radio = LoRa);
+
+  void begin();
+  void end();
+
+  // frames in flight per peer, 1 is stop-and-wait
+  void setWindow(uint8_t frames);
+
+  // returns 0 when the window to that peer is full, the message is too long
+  // or the peer table is full; the message is copied
+  int send(uint8_t to, const uint8_t *buffer, size_t size);
+  size_t pending(uint8_t to);
+
+  void onMessage(void(*callback)(uint8_t, const uint8_t*, size_t));
+  void onDelivery(void(*callback)(uint8_t, uint16_t, bool));
+
+  void poll();
+
+  // smoothed RTT and current RTO towards a peer, in microseconds
+  uint32_t rtt(uint8_t peer);
+  uint32_t rto(uint8_t peer);
+
+  const LoRaLinkStats &stats() { return _stats; }
+
+private:
+  struct Slot {
+    uint8_t length;
+    bool sent;
+    bool acked;
+    bool resend;
+    uint8_t data[LORA_LINK_PAYLOAD_SIZE];
+  };
+
+  struct Peer {
+    bool used;
+    uint8_t address;
+
+    // sender
+    uint16_t txBase;       // oldest message not acked
+    uint16_t txNext;       // sequence of the next send()
+    Slot txSlots[LORA_LINK_MAX_WINDOW];
+    bool awaitingAck;
+    uint16_t askSeq;       // frame that asked for the ACK
+    bool askResent;        // Karn: no RTT sample from a retransmission
+    uint64_t askEnd;       // estimated end of that frame on the air
+    uint32_t srtt;
+    uint32_t rttvar;
+    uint32_t rto;
+    uint8_t retries;
+
+    // receiver
+    uint16_t rxNext;       // next sequence to deliver
+    Slot rxSlots[LORA_LINK_MAX_WINDOW];
+  };
+
+  Peer *findPeer(uint8_t address, bool create);
+  void resetPeer(Peer &peer, uint8_t address);
+
+  void handleFrame(const uint8_t *frame, size_t length);
+  void handleData(Peer &peer, const uint8_t *frame, size_t length);
+  void handleAck(Peer &peer, const uint8_t *frame, size_t length);
+  void sendAck(Peer &peer);
+
+  void servicePeer(Peer &peer);
+  void sendSlot(Peer &peer, uint16_t seq, bool ask);
+  void releaseAcked(Peer &peer);
+  void sampleRtt(Peer &peer, uint64_t now);
+  int enqueue(const uint8_t *frame, size_t length);
+
+private:
+  LoRaClass &_radio;
+  uint8_t _address;
+  uint8_t _window;
+  LoRaLinkStats _stats;
+
+  // when our own TX queue will have drained, to place frames on the air
+  uint64_t _airFreeAt;
+
+  void (*_onMessage)(uint8_t, const uint8_t*, size_t);
+  void (*_onDelivery)(uint8_t, uint16_t, bool);
+
+  Peer _peers[LORA_LINK_MAX_PEERS];
+};
+
+#endif
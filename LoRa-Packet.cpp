@@ -0,0 +1,75 @@
+#include "LoRa-Packet.h"
+
+PacketRef::PacketRef(PacketRef &&other) :
+  _pool(other._pool),
+  _slab(other._slab)
+{
+  other._pool = NULL;
+  other._slab = NULL;
+}
+
+PacketRef &PacketRef::operator=(PacketRef &&other)
+{
+  if (this != &other) {
+    release();
+
+    _pool = other._pool;
+    _slab = other._slab;
+    other._pool = NULL;
+    other._slab = NULL;
+  }
+
+  return *this;
+}
+
+void PacketRef::release()
+{
+  if (_slab) {
+    _pool->release(_slab);
+    _pool = NULL;
+    _slab = NULL;
+  }
+}
+
+LoRaPacketPool::LoRaPacketPool() :
+  _dropped(0)
+{
+  for (uint8_t i = 0; i < LORA_PACKET_POOL_SIZE; i++) {
+    _free.push(i);
+  }
+}
+
+LoRaPacketSlab *LoRaPacketPool::acquire()
+{
+  uint8_t index;
+
+  if (!_free.pop(index)) {
+    // every slab is still held by the application
+    _dropped = _dropped + 1;
+    return NULL;
+  }
+
+  return &_slabs[index];
+}
+
+void LoRaPacketPool::publish(LoRaPacketSlab *slab)
+{
+  // cannot fail, there are never more slabs out than the queue holds
+  _ready.push(slab - _slabs);
+}
+
+PacketRef LoRaPacketPool::take()
+{
+  uint8_t index;
+
+  if (!_ready.pop(index)) {
+    return PacketRef();
+  }
+
+  return PacketRef(this, &_slabs[index]);
+}
+
+void LoRaPacketPool::release(LoRaPacketSlab *slab)
+{
+  _free.push(slab - _slabs);
+}
@@ -0,0 +1,94 @@
+#ifndef LORA_PACKET_H
+#define LORA_PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LoRa-Queue.h"
+
+#define LORA_PACKET_POOL_SIZE 4
+#define LORA_PACKET_SLAB_SIZE 256
+
+// Radio state of one received frame, decoded from a single burst read of
+// 0x10-0x2a at RxDone
+struct PacketInfo {
+  size_t length;
+  int rssi;            // dBm, corrected with the SNR below 0 dB
+  float snr;           // dB
+  long frequencyError; // Hz
+  uint8_t codingRate;  // 5-8, from the received header
+  bool crcOn;          // from the received header
+  uint64_t timestamp;  // time_us_64() of the RxDone edge
+};
+
+// One received frame and the radio state captured with it
+struct LoRaPacketSlab {
+  uint8_t data[LORA_PACKET_SLAB_SIZE];
+  PacketInfo info;
+};
+
+class LoRaPacketPool;
+
+// Move-only handle on a slab, the slab goes back to the pool when the handle
+// is released or destroyed.
+class PacketRef {
+public:
+  PacketRef() : _pool(NULL), _slab(NULL) {}
+  PacketRef(PacketRef &&other);
+  PacketRef &operator=(PacketRef &&other);
+  ~PacketRef() { release(); }
+
+  PacketRef(const PacketRef &) = delete;
+  PacketRef &operator=(const PacketRef &) = delete;
+
+  explicit operator bool() const { return _slab != NULL; }
+
+  const uint8_t *data() const { return _slab->data; }
+  size_t length() const { return _slab->info.length; }
+  int rssi() const { return _slab->info.rssi; }
+  float snr() const { return _slab->info.snr; }
+  long frequencyError() const { return _slab->info.frequencyError; }
+  uint64_t timestamp() const { return _slab->info.timestamp; }
+  const PacketInfo &info() const { return _slab->info; }
+
+  void release();
+
+private:
+  friend class LoRaPacketPool;
+  PacketRef(LoRaPacketPool *pool, LoRaPacketSlab *slab) : _pool(pool), _slab(slab) {}
+
+  LoRaPacketPool *_pool;
+  LoRaPacketSlab *_slab;
+};
+
+// Fixed set of slabs shared between the RX path, which fills them, and the
+// application, which takes and releases them. Both sides are lock-free, so
+// the RX path may run in the DIO0 ISR; packets must be taken and released
+// from a single context.
+class LoRaPacketPool {
+public:
+  LoRaPacketPool();
+
+  // RX path
+  LoRaPacketSlab *acquire();
+  void publish(LoRaPacketSlab *slab);
+  // back to the free list without publishing, from the application side only
+  void discard(LoRaPacketSlab *slab) { release(slab); }
+
+  // application
+  PacketRef take();
+  size_t available() { return _ready.size(); }
+  size_t freeSlabs() { return _free.size(); }
+  uint32_t dropped() { return _dropped; }
+
+private:
+  friend class PacketRef;
+  void release(LoRaPacketSlab *slab);
+
+  LoRaPacketSlab _slabs[LORA_PACKET_POOL_SIZE];
+  SpscQueue<uint8_t, LORA_PACKET_POOL_SIZE> _free;  // application -> RX path
+  SpscQueue<uint8_t, LORA_PACKET_POOL_SIZE> _ready; // RX path -> application
+  volatile uint32_t _dropped;
+};
+
+#endif
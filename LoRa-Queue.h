@@ -0,0 +1,99 @@
+#ifndef LORA_QUEUE_H
+#define LORA_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer / single-consumer ring.
+//
+// One side (an ISR, or the other core) only calls push(), the other only
+// calls pop()/peek(). Indices are free-running and only ever stored by their
+// owner, so plain acquire/release loads and stores are enough: no RMW
+// instructions, which the Cortex-M0+ does not have.
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+  SpscQueue() : _head(0), _tail(0) {}
+
+  bool push(const T &item)
+  {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+
+    if (head - _tail.load(std::memory_order_acquire) >= N) {
+      return false;
+    }
+
+    _items[head & (N - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  // producer side: fill the next slot in place, then publish it with commit()
+  T *reserve()
+  {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+
+    if (head - _tail.load(std::memory_order_acquire) >= N) {
+      return NULL;
+    }
+
+    return &_items[head & (N - 1)];
+  }
+
+  void commit()
+  {
+    _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // consumer side: drop the item returned by peek()
+  void discard()
+  {
+    _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  bool pop(T &item)
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+
+    if (tail == _head.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    item = _items[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  // consumer side: look at the oldest item without removing it
+  T *peek()
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+
+    if (tail == _head.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+
+    return &_items[tail & (N - 1)];
+  }
+
+  size_t size() const
+  {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+  bool full() const { return size() >= N; }
+  static size_t capacity() { return N; }
+
+private:
+  T _items[N];
+  std::atomic<uint32_t> _head;
+  std::atomic<uint32_t> _tail;
+};
+
+#endif
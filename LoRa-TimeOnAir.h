@@ -0,0 +1,76 @@
+#ifndef LORA_TIME_ON_AIR_H
+#define LORA_TIME_ON_AIR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Time on air of a LoRa frame, SX1276 datasheet 4.1.1.7. Everything is
+// constexpr so timeouts and budgets for a fixed configuration can be worked
+// out at compile time; LoRaClass::timeOnAir() does the same with the
+// current modem settings. The header also builds as C11 (static inline, no
+// default arguments) so the plain C rfm95w driver shares the formula.
+
+#ifdef __cplusplus
+#define LORA_CONSTEXPR constexpr
+#else
+#include <stdbool.h>
+#define LORA_CONSTEXPR static inline
+#endif
+
+// bandwidth in Hz, result in microseconds
+LORA_CONSTEXPR uint32_t loraSymbolTimeUs(int sf, long bw)
+{
+  return (uint32_t)(((uint64_t)1000000 << sf) / bw);
+}
+
+// LowDataRateOptimize is mandatory once a symbol lasts more than 16 ms:
+// SF11 and SF12 at 125 kHz, SF12 at 250 kHz, SF10 and up below 125 kHz
+LORA_CONSTEXPR bool loraLowDataRateOptimize(int sf, long bw)
+{
+  return loraSymbolTimeUs(sf, bw) > 16000;
+}
+
+// cr is the coding rate denominator (5-8 for 4/5 to 4/8), preamble the
+// programmed length without the 4.25 symbols the radio adds
+LORA_CONSTEXPR uint32_t loraTimeOnAirUs(size_t length, int sf, long bw, int cr, long preamble,
+                                             bool crc, bool implicitHeader, bool lowDataRateOptimize)
+{
+  // SF6 only works in implicit header mode
+  int ih = implicitHeader || sf == 6;
+  int numerator = 8 * (int)length - 4 * sf + 28 + 16 * crc - 20 * ih;
+  int denominator = 4 * (sf - 2 * lowDataRateOptimize);
+  int payloadSymbols = 8;
+
+  if (numerator > 0) {
+    payloadSymbols += (numerator + denominator - 1) / denominator * cr;
+  }
+
+  // in quarter symbols to keep the 4.25 exact
+  uint64_t quarters = 4 * (uint64_t)preamble + 17 + 4 * (uint64_t)payloadSymbols;
+
+  return (uint32_t)(((quarters << sf) * 1000000) / (4 * (uint64_t)bw));
+}
+
+#ifdef __cplusplus
+// same, with LowDataRateOptimize picked the way the driver does
+constexpr uint32_t loraTimeOnAirUs(size_t length, int sf, long bw, int cr = 5, long preamble = 8,
+                                   bool crc = true, bool implicitHeader = false)
+{
+  return loraTimeOnAirUs(length, sf, bw, cr, preamble, crc, implicitHeader,
+                         loraLowDataRateOptimize(sf, bw));
+}
+#endif
+
+// preamble, in symbols, a sender needs so that a receiver sampling the
+// channel with CAD every intervalUs always catches it: one whole interval,
+// plus the CAD itself and the symbols RX_SINGLE needs to lock, with margin
+LORA_CONSTEXPR long loraWakePreamble(uint32_t intervalUs, int sf, long bw)
+{
+  uint32_t symbol = loraSymbolTimeUs(sf, bw);
+  uint32_t symbols = (intervalUs + symbol - 1) / symbol + 8;
+
+  // REG_PREAMBLE is 16 bits
+  return symbols > 0xffff ? 0xffff : symbols;
+}
+
+#endif
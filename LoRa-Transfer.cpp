@@ -0,0 +1,275 @@
+#include "LoRa-Transfer.h"
+
+// frame types, first byte of every frame
+#define TRANSFER_DATA      0xd0
+#define TRANSFER_DATA_ASK  0xd1 // last fragment of a round, answer with an ACK
+#define TRANSFER_ACK       0xda
+
+// DATA: type, id, index, count, total length (LE), payload
+// ACK:  type, id, count, bitmap of the fragments received
+#define TRANSFER_ACK_SIZE  (3 + LORA_TRANSFER_BITMAP_SIZE)
+
+static size_t fragmentCount(size_t total)
+{
+  return (total + LORA_TRANSFER_FRAGMENT_SIZE - 1) / LORA_TRANSFER_FRAGMENT_SIZE;
+}
+
+static size_t fragmentLength(size_t total, uint8_t index)
+{
+  size_t offset = (size_t)index * LORA_TRANSFER_FRAGMENT_SIZE;
+
+  return total - offset < LORA_TRANSFER_FRAGMENT_SIZE ? total - offset : LORA_TRANSFER_FRAGMENT_SIZE;
+}
+
+static bool testBit(const uint8_t *bitmap, uint8_t index)
+{
+  return bitmap[index >> 3] & (1 << (index & 7));
+}
+
+static void setBit(uint8_t *bitmap, uint8_t index)
+{
+  bitmap[index >> 3] |= 1 << (index & 7);
+}
+
+LoRaTransfer::LoRaTransfer(LoRaClass &radio) :
+  _radio(radio),
+  _stats(),
+  _state(LORA_TRANSFER_IDLE),
+  _txBuffer(NULL),
+  _txLength(0),
+  _txId(0),
+  _txCount(0),
+  _roundNext(0),
+  _roundLast(0),
+  _roundCount(0),
+  _ackDeadline(0),
+  _rxActive(false),
+  _rxHeld(false),
+  _rxId(0),
+  _rxCount(0),
+  _rxLength(0),
+  _rxReceived(0)
+{
+}
+
+void LoRaTransfer::begin()
+{
+  _radio.enablePacketPool();
+
+  // the TX queue goes back to RX after each burst when it finds the radio receiving
+  _radio.receive();
+}
+
+void LoRaTransfer::end()
+{
+  _radio.disablePacketPool();
+
+  if (_state == LORA_TRANSFER_SENDING) {
+    _state = LORA_TRANSFER_FAILED;
+  }
+}
+
+int LoRaTransfer::send(const uint8_t *buffer, size_t size)
+{
+  if (_state == LORA_TRANSFER_SENDING || size == 0 || size > LORA_TRANSFER_MAX_SIZE) {
+    return 0;
+  }
+
+  _txBuffer = buffer;
+  _txLength = size;
+  _txCount = fragmentCount(size);
+  _txId++;
+  memset(_txAcked, 0, sizeof(_txAcked));
+  memset(_txSent, 0, sizeof(_txSent));
+
+  _roundCount = 0;
+  _state = LORA_TRANSFER_SENDING;
+  startRound(false);
+
+  return 1;
+}
+
+void LoRaTransfer::poll()
+{
+  // deferred IRQs and duty-cycle holds of the radio itself
+  _radio.poll();
+
+  while (PacketRef packet = _radio.takePacket()) {
+    handleFrame(packet.data(), packet.length());
+  }
+
+  if (_state != LORA_TRANSFER_SENDING) {
+    return;
+  }
+
+  if (!_ackDeadline) {
+    fillTxQueue();
+  } else if (time_us_64() >= _ackDeadline && _radio.txQueueDepth() == 0) {
+    // the ACK, or the fragment asking for it, got lost
+    _stats.timeouts++;
+    startRound(true);
+  }
+}
+
+void LoRaTransfer::startRound(bool askOnly)
+{
+  if (_roundCount >= LORA_TRANSFER_MAX_ROUNDS) {
+    _state = LORA_TRANSFER_FAILED;
+    return;
+  }
+
+  _roundCount++;
+  _stats.rounds++;
+
+  // the last fragment still missing asks for the ACK
+  _roundLast = _txCount - 1;
+  while (testBit(_txAcked, _roundLast)) {
+    _roundLast--;
+  }
+
+  _roundNext = askOnly ? _roundLast : 0;
+  _ackDeadline = 0;
+
+  fillTxQueue();
+}
+
+void LoRaTransfer::fillTxQueue()
+{
+  while (_roundNext <= _roundLast && _radio.txQueueDepth() < LORA_TX_QUEUE_SIZE) {
+    uint8_t index = _roundNext++;
+
+    if (!testBit(_txAcked, index)) {
+      sendFragment(index, index == _roundLast);
+    }
+  }
+
+  if (_roundNext > _roundLast) {
+    // whole round queued: its airtime plus the frame already on the air, the
+    // ACK's and the receiver's turnaround
+    _ackDeadline = time_us_64() +
+                   (_radio.txQueueDepth() + 1) * _radio.timeOnAir(LORA_TX_FIFO_SIZE) +
+                   _radio.timeOnAir(TRANSFER_ACK_SIZE) + LORA_TRANSFER_ACK_MARGIN_US;
+  }
+}
+
+void LoRaTransfer::sendFragment(uint8_t index, bool ask)
+{
+  uint8_t frame[LORA_TX_FIFO_SIZE];
+  size_t length = fragmentLength(_txLength, index);
+
+  frame[0] = ask ? TRANSFER_DATA_ASK : TRANSFER_DATA;
+  frame[1] = _txId;
+  frame[2] = index;
+  frame[3] = _txCount;
+  frame[4] = _txLength & 0xff;
+  frame[5] = _txLength >> 8;
+  memcpy(frame + LORA_TRANSFER_HEADER_SIZE, _txBuffer + (size_t)index * LORA_TRANSFER_FRAGMENT_SIZE, length);
+
+  _radio.enqueue(frame, LORA_TRANSFER_HEADER_SIZE + length);
+
+  if (testBit(_txSent, index)) {
+    _stats.retransmitted++;
+  } else {
+    setBit(_txSent, index);
+    _stats.fragmentsSent++;
+  }
+}
+
+void LoRaTransfer::handleFrame(const uint8_t *frame, size_t length)
+{
+  if (length == 0) {
+    return;
+  }
+
+  if (frame[0] == TRANSFER_DATA || frame[0] == TRANSFER_DATA_ASK) {
+    handleData(frame, length);
+  } else if (frame[0] == TRANSFER_ACK) {
+    handleAck(frame, length);
+  }
+
+  // anything else is not ours
+}
+
+void LoRaTransfer::handleData(const uint8_t *frame, size_t length)
+{
+  if (length < LORA_TRANSFER_HEADER_SIZE) {
+    return;
+  }
+
+  uint8_t id = frame[1];
+  uint8_t index = frame[2];
+  uint8_t count = frame[3];
+  size_t total = frame[4] | (frame[5] << 8);
+
+  if (total == 0 || total > LORA_TRANSFER_MAX_SIZE || count != fragmentCount(total) || index >= count ||
+      length - LORA_TRANSFER_HEADER_SIZE != fragmentLength(total, index)) {
+    return;
+  }
+
+  if (!_rxActive || id != _rxId || total != _rxLength) {
+    if (_rxHeld) {
+      // the last buffer has not been taken yet
+      return;
+    }
+
+    _rxActive = true;
+    _rxId = id;
+    _rxCount = count;
+    _rxLength = total;
+    _rxReceived = 0;
+    memset(_rxBitmap, 0, sizeof(_rxBitmap));
+  }
+
+  if (!testBit(_rxBitmap, index)) {
+    memcpy(_rxBuffer + (size_t)index * LORA_TRANSFER_FRAGMENT_SIZE, frame + LORA_TRANSFER_HEADER_SIZE,
+           length - LORA_TRANSFER_HEADER_SIZE);
+    setBit(_rxBitmap, index);
+
+    if (++_rxReceived == _rxCount) {
+      _rxHeld = true;
+    }
+  }
+
+  if (frame[0] == TRANSFER_DATA_ASK) {
+    sendAck();
+  }
+}
+
+void LoRaTransfer::handleAck(const uint8_t *frame, size_t length)
+{
+  if (_state != LORA_TRANSFER_SENDING || length < TRANSFER_ACK_SIZE || frame[1] != _txId ||
+      frame[2] != _txCount) {
+    return;
+  }
+
+  bool complete = true;
+
+  for (size_t i = 0; i < LORA_TRANSFER_BITMAP_SIZE; i++) {
+    _txAcked[i] |= frame[3 + i];
+  }
+  for (uint8_t i = 0; i < _txCount; i++) {
+    complete = complete && testBit(_txAcked, i);
+  }
+
+  if (complete) {
+    _ackDeadline = 0;
+    _state = LORA_TRANSFER_DONE;
+  } else if (_ackDeadline) {
+    // the answer to this round, resend what it says is missing
+    startRound(false);
+  }
+}
+
+void LoRaTransfer::sendAck()
+{
+  uint8_t frame[TRANSFER_ACK_SIZE];
+
+  frame[0] = TRANSFER_ACK;
+  frame[1] = _rxId;
+  frame[2] = _rxCount;
+  memcpy(frame + 3, _rxBitmap, LORA_TRANSFER_BITMAP_SIZE);
+
+  if (_radio.enqueue(frame, sizeof(frame))) {
+    _stats.acksSent++;
+  }
+}
@@ -0,0 +1,105 @@
+#ifndef LORA_TRANSFER_H
+#define LORA_TRANSFER_H
+
+#include "Lora-RP2040.h"
+
+// largest buffer one transfer carries; a fragment plus its header fills the
+// TX half of the FIFO exactly
+#define LORA_TRANSFER_MAX_SIZE       4096
+#define LORA_TRANSFER_HEADER_SIZE    6
+#define LORA_TRANSFER_FRAGMENT_SIZE  (LORA_TX_FIFO_SIZE - LORA_TRANSFER_HEADER_SIZE)
+#define LORA_TRANSFER_MAX_FRAGMENTS  ((LORA_TRANSFER_MAX_SIZE + LORA_TRANSFER_FRAGMENT_SIZE - 1) / LORA_TRANSFER_FRAGMENT_SIZE)
+#define LORA_TRANSFER_BITMAP_SIZE    ((LORA_TRANSFER_MAX_FRAGMENTS + 7) / 8)
+
+// ACK requests (rounds) before a transfer is given up
+#define LORA_TRANSFER_MAX_ROUNDS     8
+
+// time the receiver gets to answer, on top of the airtime still queued
+#define LORA_TRANSFER_ACK_MARGIN_US  50000
+
+enum LoRaTransferState {
+  LORA_TRANSFER_IDLE,
+  LORA_TRANSFER_SENDING,
+  LORA_TRANSFER_DONE,
+  LORA_TRANSFER_FAILED
+};
+
+struct LoRaTransferStats {
+  uint32_t fragmentsSent; // first transmissions
+  uint32_t retransmitted; // fragments sent again
+  uint32_t rounds;        // ACK requests
+  uint32_t timeouts;      // ACK requests nobody answered
+  uint32_t acksSent;
+};
+
+// Transport for buffers larger than one frame. The sender cuts the buffer
+// into numbered fragments and sends them in rounds; the last fragment of a
+// round asks for an ACK whose bitmap tells which fragments have arrived, and
+// the next round resends only the missing ones (selective repeat). A round
+// that gets no ACK resends just its last fragment to ask again. The
+// receiver places fragments by number into a bounded buffer, in any order.
+//
+// Both ends run from poll(): frames leave through the radio's TX queue and
+// arrive through its packet pool, so the transfer owns the radio between
+// begin() and end(). One transfer at a time in each direction.
+class LoRaTransfer {
+public:
+  LoRaTransfer(LoRaClass &radio = LoRa);
+
+  void begin();
+  void end();
+
+  // sender side, returns 0 if a transfer is still going or size is out of
+  // range; the buffer must stay valid while the state is SENDING
+  int send(const uint8_t *buffer, size_t size);
+  uint8_t state() { return _state; }
+
+  // receiver side: a complete buffer is held until release(), fragments of
+  // a new transfer are ignored meanwhile (the sender retries them)
+  size_t available() { return _rxHeld ? _rxLength : 0; }
+  const uint8_t *data() { return _rxBuffer; }
+  void release() { _rxHeld = false; }
+
+  void poll();
+
+  const LoRaTransferStats &stats() { return _stats; }
+
+private:
+  void handleFrame(const uint8_t *frame, size_t length);
+  void handleData(const uint8_t *frame, size_t length);
+  void handleAck(const uint8_t *frame, size_t length);
+  void sendAck();
+
+  void startRound(bool askOnly);
+  void fillTxQueue();
+  void sendFragment(uint8_t index, bool ask);
+
+private:
+  LoRaClass &_radio;
+  LoRaTransferStats _stats;
+
+  // sender
+  uint8_t _state;
+  const uint8_t *_txBuffer;
+  size_t _txLength;
+  uint8_t _txId;
+  uint8_t _txCount;
+  uint8_t _txAcked[LORA_TRANSFER_BITMAP_SIZE];
+  uint8_t _txSent[LORA_TRANSFER_BITMAP_SIZE];
+  uint8_t _roundNext;     // next fragment to queue in this round
+  uint8_t _roundLast;     // the one that asks for the ACK
+  uint32_t _roundCount;
+  uint64_t _ackDeadline;  // 0 while the round is still being queued
+
+  // receiver
+  uint8_t _rxBuffer[LORA_TRANSFER_MAX_SIZE];
+  bool _rxActive;
+  bool _rxHeld;
+  uint8_t _rxId;
+  uint8_t _rxCount;
+  size_t _rxLength;
+  size_t _rxReceived;
+  uint8_t _rxBitmap[LORA_TRANSFER_BITMAP_SIZE];
+};
+
+#endif
@@ -5,12 +5,17 @@
   com base nas condições do canal (RSSI e SNR), implementando um
   mecanismo de adaptação automática para otimizar a comunicação.
   
+  Quando todas as mensagens foram confirmadas, o nó escuta só por uma janela
+  RX_SINGLE, para o que o outro lado tiver a enviar, e dorme até o próximo
+  envio, como a classe A do LoRaWAN.
+  
   Utiliza a biblioteca pico-lora para Raspberry Pi Pico com módulo RFM95W.
   
   Conexões:
   - CS: GPIO 8
   - RESET: GPIO 9
   - DIO0/IRQ: GPIO 7
+  - DIO1: GPIO 6 (RxTimeout, fecha a janela de escuta)
   - MISO: GPIO 16
   - MOSI: GPIO 19
   - SCK: GPIO 18
@@ -23,8 +28,9 @@
 #include "string.h"
 #include <string>
 
-// Incluir biblioteca LoRa
+// Incluir biblioteca LoRa e o enlace confiável
 #include "Lora-RP2040.h"
+#include "LoRa-Link.h"
 
 // Definir o tipo byte como uint8_t
 typedef uint8_t byte;
@@ -35,6 +41,7 @@ using std::string;
 const int csPin = 8;          // LoRa radio chip select
 const int resetPin = 9;       // LoRa radio reset
 const int irqPin = 7;         // LoRa radio IRQ/DIO0
+const int dio1Pin = 6;        // LoRa radio DIO1 (RxTimeout)
 
 // Parâmetros iniciais de configuração LoRa
 const long frequency = 915E6;  // Frequência em Hz (915MHz)
@@ -49,8 +56,12 @@ const int syncWord = 0x34;     // Palavra de sincronização (0x34 é o padrão)
 const byte localAddress = 0xBB;     // Endereço deste dispositivo
 const byte destinationAddress = 0xAA; // Endereço do dispositivo de destino
 
+// Enlace confiável: janela de quadros em voo, ACKs cumulativos e seletivos,
+// números de sequência de 16 bits por destino e RTO medido
+LoRaLink loraLink(localAddress);
+
 // Variáveis para controle de envio
-uint8_t msgCount = 0;          // Contador de mensagens enviadas
+uint16_t msgCount = 0;         // Contador de mensagens enviadas
 int interval = 2000;           // Intervalo entre envios (ms)
 long lastSendTime = 0;         // Timestamp do último envio
 
@@ -60,11 +71,15 @@ float lastSnr = 0.0;           // Último SNR recebido
 int consecutiveFails = 0;      // Contador de falhas consecutivas
 int consecutiveSuccess = 0;    // Contador de sucessos consecutivos
 const int adaptationThreshold = 3; // Limiar para adaptação
-bool ackReceived = false;      // Flag para confirmação de recebimento
-long ackTimeout = 1000;        // Timeout para aguardar ACK (ms)
 long lastAdaptationTime = 0;   // Timestamp da última adaptação
 const long adaptationCooldown = 10000; // Período mínimo entre adaptações (ms)
 
+// Janela de escuta depois de cada troca, no lugar do RX contínuo
+const long listenWindowMs = 200; // Duração da janela (ms)
+bool listening = false;          // Janela RX_SINGLE aberta
+bool windowClosed = false;       // Janela fechada por timeout ou por um quadro
+bool radioAsleep = false;        // Rádio dormindo até o próximo envio
+
 // Estrutura para armazenar configurações LoRa
 struct LoRaConfig {
   int sf;
@@ -103,6 +118,10 @@ void applyConfig(LoRaConfig config) {
   LoRa.setTxPower(txPower, PA_OUTPUT_PA_BOOST_PIN);
   LoRa.receive();
   
+  // O RX contínuo substitui qualquer janela em andamento
+  listening = false;
+  radioAsleep = false;
+  
   // Registrar timestamp da adaptação
   lastAdaptationTime = to_ms_since_boot(get_absolute_time());
   
@@ -186,141 +205,82 @@ void adaptParameters() {
   }
 }
 
+// Abrir a janela de escuta, em símbolos da configuração atual
+void openListenWindow() {
+  long symbols = listenWindowMs * 1000 / LoRa.symbolTime();
+  if (symbols < 4) symbols = 4;
+  if (symbols > 1023) symbols = 1023;
+  
+  // RX_SINGLE volta sozinho ao standby; o DIO1 avisa o fim da janela
+  LoRa.receiveWindow(symbols);
+  listening = true;
+  windowClosed = false;
+}
+
+// Callback quando a janela RX_SINGLE fecha sem nenhum preâmbulo
+void onRxTimeout() {
+  windowClosed = true;
+}
+
 // Função para enviar mensagem
 void sendMessage(string message) {
-  // Colocar o rádio em modo de transmissão
-  LoRa.idle();
-  
-  // Iniciar pacote
-  LoRa.beginPacket();
-  
-  // Adicionar cabeçalho
-  LoRa.write(destinationAddress);  // Endereço de destino
-  LoRa.write(localAddress);        // Endereço do remetente
-  LoRa.write(msgCount);            // ID da mensagem
-  LoRa.write(message.length());    // Comprimento do payload
-  
-  // Adicionar payload
-  LoRa.print(message.c_str());
+  // Acordar o rádio em RX contínuo: a fila de TX volta a ele depois do
+  // quadro, e o ACK do enlace chega sem depender de uma janela
+  if (listening || radioAsleep) {
+    LoRa.receive();
+    listening = false;
+    radioAsleep = false;
+  }
   
-  // Finalizar e enviar pacote
-  LoRa.endPacket(true);  // true para envio assíncrono
+  // O enlace copia a mensagem e a envia no próximo loraLink.poll(), junto com as
+  // outras que estiverem na janela; a confirmação chega em onDelivery()
+  if (!loraLink.send(destinationAddress, (const uint8_t *)message.c_str(), message.length())) {
+    printf("Janela cheia para 0x%02X, mensagem descartada: %s\n", destinationAddress, message.c_str());
+    return;
+  }
   
   printf("Mensagem enviada para 0x%02X: %s\n", destinationAddress, message.c_str());
   printf("Configuração atual: SF=%d, BW=%ld Hz, CR=4/%d, TX Power=%d dBm\n", 
          spreadingFactor, signalBandwidth, codingRate, txPower);
-  
-  // Resetar flag de ACK
-  ackReceived = false;
-  
-  // Aguardar ACK
-  long ackStartTime = to_ms_since_boot(get_absolute_time());
-  printf("Aguardando ACK...");
-  
-  while (!ackReceived && (to_ms_since_boot(get_absolute_time()) - ackStartTime < ackTimeout)) {
-    sleep_ms(10);
-  }
-  
-  if (ackReceived) {
-    printf(" ACK recebido!\n");
+}
+
+// Callback quando uma mensagem é confirmada ou abandonada pelo enlace
+void onDelivery(byte toAddress, uint16_t seq, bool acked) {
+  if (acked) {
+    // O último quadro recebido foi o ACK: ele mede a qualidade do canal
+    lastRssi = LoRa.packetRssi();
+    lastSnr = LoRa.packetSnr();
+    
+    printf("ACK de 0x%02X (seq %u, RTT %lu us, RSSI %d dBm, SNR %.2f dB)\n",
+           toAddress, seq, (unsigned long)loraLink.rtt(toAddress), lastRssi, lastSnr);
     consecutiveSuccess++;
     consecutiveFails = 0;
   } else {
-    printf(" Timeout de ACK!\n");
+    printf("Mensagem seq %u para 0x%02X abandonada após %d timeouts\n",
+           seq, toAddress, LORA_LINK_MAX_RETRIES);
     consecutiveFails++;
     consecutiveSuccess = 0;
   }
-  
-  // Verificar se é necessário adaptar parâmetros
-  adaptParameters();
-}
-
-// Função para enviar ACK
-void sendAck(byte toAddress, byte msgId) {
-  // Colocar o rádio em modo de transmissão
-  LoRa.idle();
-  
-  // Iniciar pacote
-  LoRa.beginPacket();
-  
-  // Adicionar cabeçalho
-  LoRa.write(toAddress);     // Endereço de destino
-  LoRa.write(localAddress);  // Endereço do remetente
-  LoRa.write(msgId);         // ID da mensagem original
-  LoRa.write(3);             // Comprimento do payload
-  
-  // Adicionar payload ("ACK")
-  LoRa.print("ACK");
-  
-  // Finalizar e enviar pacote
-  LoRa.endPacket(true);
-  
-  printf("ACK enviado para 0x%02X (MsgID: %d)\n", toAddress, msgId);
 }
 
-// Função para processar pacotes recebidos
-void onReceive(int packetSize) {
-  // Ignorar pacotes vazios
-  if (packetSize == 0) return;
-  
-  // Ler cabeçalho
-  byte recipient = LoRa.read();      // Endereço de destino
-  byte sender = LoRa.read();         // Endereço do remetente
-  byte incomingMsgId = LoRa.read();  // ID da mensagem
-  byte incomingLength = LoRa.read(); // Comprimento do payload
-  
-  // Criar buffer para a mensagem
-  string message = "";
+// Callback para mensagens recebidas, já em ordem e sem duplicatas
+void onMessage(byte sender, const uint8_t *buffer, size_t size) {
+  char message[LORA_LINK_PAYLOAD_SIZE + 1];
   
-  // Ler payload
-  while (LoRa.available()) {
-    message += (char)LoRa.read();
+  // Um quadro recebido também encerra a janela
+  if (listening) {
+    windowClosed = true;
   }
   
-  // Verificar se o comprimento está correto
-  if (incomingLength != message.length()) {
-    printf("Erro: comprimento da mensagem não corresponde.\n");
-    return;
-  }
-  
-  // Armazenar informações de qualidade do sinal
-  lastRssi = LoRa.packetRssi();
-  lastSnr = LoRa.packetSnr();
-  
-  // Verificar se a mensagem é para este dispositivo
-  if (recipient == localAddress) {
-    // Exibir informações do pacote recebido
-    printf("\nPacote recebido de: 0x%02X\n", sender);
-    printf("ID da mensagem: %d\n", incomingMsgId);
-    printf("Comprimento: %d\n", incomingLength);
-    printf("Mensagem: %s\n", message.c_str());
-    printf("RSSI: %d dBm\n", lastRssi);
-    printf("SNR: %.2f dB\n", lastSnr);
-    
-    // Verificar se é um ACK
-    if (message == "ACK") {
-      ackReceived = true;
-    } else {
-      // Enviar ACK para mensagens normais
-      sendAck(sender, incomingMsgId);
-    }
-  } else if (recipient == 0xFF) {
-    // Mensagem de broadcast
-    printf("\nMensagem de broadcast recebida de: 0x%02X\n", sender);
-    printf("ID da mensagem: %d\n", incomingMsgId);
-    printf("Mensagem: %s\n", message.c_str());
-    printf("RSSI: %d dBm\n", lastRssi);
-    printf("SNR: %.2f dB\n", lastSnr);
-  }
+  memcpy(message, buffer, size);
+  message[size] = '\0';
   
-  // Após receber, voltar ao modo de recepção
-  LoRa.receive();
-}
-
-// Callback quando a transmissão for concluída
-void onTxDone() {
-  // Voltar ao modo de recepção após transmitir
-  LoRa.receive();
+  // Exibir informações do pacote recebido
+  printf("\nMensagem recebida de: 0x%02X\n", sender);
+  printf("Comprimento: %d\n", (int)size);
+  printf("Mensagem: %s\n", message);
+  printf("RSSI: %d dBm\n", LoRa.packetRssi());
+  printf("SNR: %.2f dB\n", LoRa.packetSnr());
 }
 
 int main() {
@@ -331,8 +291,13 @@ int main() {
   printf("Endereço local: 0x%02X\n", localAddress);
   printf("Endereço de destino: 0x%02X\n", destinationAddress);
   
+  // Informar ao picotool os pinos usados por este exemplo
+  bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
+  bi_decl(bi_3pins_with_names(csPin, "LoRa CS", resetPin, "LoRa RESET", irqPin, "LoRa DIO0"));
+  bi_decl(bi_1pin_with_name(dio1Pin, "LoRa DIO1"));
+  
   // Configurar pinos do LoRa
-  LoRa.setPins(csPin, resetPin, irqPin);
+  LoRa.setPins(csPin, resetPin, irqPin, dio1Pin);
   
   // Inicializar o rádio LoRa
   if (!LoRa.begin(frequency)) {
@@ -349,9 +314,15 @@ int main() {
   LoRa.setSyncWord(syncWord);
   LoRa.enableCrc();
   
-  // Configurar callbacks
-  LoRa.onReceive(onReceive);
-  LoRa.onTxDone(onTxDone);
+  // Tratar o DIO0 fora da interrupção: o enlace e applyConfig() usam o SPI
+  // no laço principal, e a ISR não disputa o barramento com eles. Os
+  // eventos são processados por loraLink.poll().
+  LoRa.setDeferredIrq(true);
+  
+  // Configurar callbacks do enlace e o fim da janela de escuta
+  loraLink.onMessage(onMessage);
+  loraLink.onDelivery(onDelivery);
+  LoRa.onRxTimeout(onRxTimeout);
   
   printf("Inicialização do LoRa concluída com sucesso!\n");
   printf("Configuração inicial:\n");
@@ -363,11 +334,12 @@ int main() {
   printf("- Comprimento do Preâmbulo: %d\n", preambleLength);
   printf("- Palavra de Sincronização: 0x%02X\n", syncWord);
   printf("- Limiar de adaptação: %d\n", adaptationThreshold);
-  printf("- Timeout de ACK: %ld ms\n", ackTimeout);
+  printf("- Janela do enlace: %d quadros\n", LORA_LINK_MAX_WINDOW);
   printf("- Período de cooldown: %ld ms\n", adaptationCooldown);
+  printf("- Janela de escuta: %ld ms (RX_SINGLE)\n", listenWindowMs);
   
-  // Iniciar em modo de recepção
-  LoRa.receive();
+  // Iniciar o enlace, que deixa o rádio em modo de recepção
+  loraLink.begin();
   printf("\nDispositivo pronto para enviar e receber mensagens...\n\n");
   
   // Loop principal
@@ -389,8 +361,27 @@ int main() {
       interval = rand() % 1000 + 2000;
     }
     
-    // Pequena pausa para economizar CPU
-    sleep_ms(100);
+    // Processar quadros recebidos, ACKs e retransmissões
+    loraLink.poll();
+    
+    // Tudo confirmado e nada na fila de TX nem no ar: escutar só por uma janela
+    bool txIdle = LoRa.txQueueDepth() == 0 && !LoRa.txQueueBusy();
+    if (!listening && !radioAsleep && loraLink.pending(destinationAddress) == 0 && txIdle) {
+      openListenWindow();
+    }
+    
+    // Janela fechada e o ACK de um quadro recebido nela já enviado: dormir
+    if (listening && windowClosed && txIdle) {
+      LoRa.sleep();
+      listening = false;
+      radioAsleep = true;
+    }
+    
+    // Verificar se é necessário adaptar parâmetros
+    adaptParameters();
+    
+    // Pequena pausa para economizar CPU; o tempo de resposta ao ACK entra no RTT
+    sleep_ms(1);
   }
   
   return 0;
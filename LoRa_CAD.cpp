@@ -3,7 +3,10 @@
   
   Este código demonstra como usar a funcionalidade CAD (Channel Activity Detection)
   do módulo LoRa para verificar se o canal está ocupado antes de transmitir.
-  Isso é útil para implementar mecanismos simples de CSMA (Carrier Sense Multiple Access).
+  O acesso ao canal (listen-before-talk) fica no driver: cada mensagem vai
+  para a fila de TX, o driver faz o CAD, espera um backoff exponencial
+  aleatório em um alarme se o canal estiver ocupado e transmite sozinho
+  quando ele estiver livre, sem bloquear o laço principal nem a interrupção.
   
   Utiliza a biblioteca pico-lora para Raspberry Pi Pico com módulo RFM95W.
   
@@ -47,73 +50,35 @@ uint8_t msgCount = 0;          // Contador de mensagens enviadas
 int interval = 2000;           // Intervalo entre envios (ms)
 long lastSendTime = 0;         // Timestamp do último envio
 
-// Variáveis para controle de CAD
-bool channelBusy = false;      // Flag para indicar se o canal está ocupado
-int cadAttempts = 0;           // Contador de tentativas de CAD
-const int maxCadAttempts = 10; // Número máximo de tentativas de CAD
+// Parâmetros do acesso ao canal (listen-before-talk)
+const int maxCadAttempts = 10; // Número máximo de tentativas de CAD por mensagem
+const int minBackoffExp = 2;   // Janela inicial: 2^2 slots
+const int maxBackoffExp = 7;   // Janela máxima: 2^7 slots
+const int rssiThreshold = -90; // Canal também precisa estar abaixo de -90 dBm
 
 // Função para enviar mensagem
 void sendMessage(string message) {
-  printf("Verificando atividade no canal...\n");
-  
-  // Resetar variáveis de controle de CAD
-  channelBusy = false;
-  cadAttempts = 0;
-  
-  // Executar CAD (Channel Activity Detection)
-  LoRa.channelActivityDetection();
-  
-  // Aguardar resultado do CAD (será processado no callback onCadDone)
-  while (cadAttempts == 0) {
-    sleep_ms(10);
-  }
-  
-  // Se o canal estiver ocupado após todas as tentativas, abortar
-  if (channelBusy) {
-    printf("Canal ocupado após %d tentativas. Abortando transmissão.\n", cadAttempts);
+  // A mensagem entra na fila; CAD, backoff e transmissão ficam com o driver
+  if (!LoRa.enqueue((const uint8_t *)message.c_str(), message.length())) {
+    printf("Fila de TX cheia, mensagem descartada: %s\n", message.c_str());
     return;
   }
   
-  // Canal livre, prosseguir com a transmissão
-  printf("Canal livre após %d tentativa(s). Iniciando transmissão...\n", cadAttempts);
-  
-  // Colocar o rádio em modo de transmissão
-  LoRa.idle();
-  
-  // Iniciar pacote
-  LoRa.beginPacket();
-  
-  // Adicionar payload
-  LoRa.print(message.c_str());
-  
-  // Finalizar e enviar pacote
-  LoRa.endPacket(true);  // true para envio assíncrono
-  
-  printf("Mensagem enviada: %s\n", message.c_str());
+  printf("Mensagem na fila: %s\n", message.c_str());
 }
 
-// Callback para resultado do CAD
-void onCadDone(bool cadResult) {
-  cadAttempts++;
+// Exibir estatísticas do acesso ao canal
+void printLbtStats() {
+  const LoRaLbtStats &stats = LoRa.lbtStats();
   
-  if (cadResult) {
-    // Sinal LoRa detectado no canal
-    printf("CAD: Sinal detectado no canal (tentativa %d)\n", cadAttempts);
-    
-    if (cadAttempts < maxCadAttempts) {
-      // Tentar novamente após um tempo aleatório (backoff)
-      int backoff = rand() % 200 + 100;  // 100-300ms
-      printf("Aguardando %d ms antes da próxima tentativa...\n", backoff);
-      sleep_ms(backoff);
-      LoRa.channelActivityDetection();
-    } else {
-      // Número máximo de tentativas atingido
-      channelBusy = true;
+  printf("LBT: %lu CADs, %lu ocupados, %lu por RSSI, %lu descartadas, %llu ms de backoff\n",
+         (unsigned long)stats.cads, (unsigned long)stats.busy, (unsigned long)stats.rssiBusy,
+         (unsigned long)stats.dropped, (unsigned long long)(stats.backoffUs / 1000));
+  
+  for (int i = 0; i < maxCadAttempts; i++) {
+    if (stats.sentAfter[i]) {
+      printf("  enviadas na tentativa %d: %lu\n", i + 1, (unsigned long)stats.sentAfter[i]);
     }
-  } else {
-    // Nenhum sinal detectado, canal livre
-    printf("CAD: Canal livre (tentativa %d)\n", cadAttempts);
-    channelBusy = false;
   }
 }
 
@@ -122,17 +87,14 @@ void onReceive(int packetSize) {
   // Ignorar pacotes vazios
   if (packetSize == 0) return;
   
-  // Criar buffer para a mensagem
-  string message = "";
-  
-  // Ler bytes do pacote
-  while (LoRa.available()) {
-    message += (char)LoRa.read();
-  }
+  // Ler bytes do pacote da FIFO em uma única rajada
+  char message[256];
+  int messageLength = LoRa.readPacket((uint8_t *)message, sizeof(message) - 1);
+  message[messageLength] = '\0';
   
   // Exibir informações do pacote recebido
   printf("\nPacote recebido:\n");
-  printf("Mensagem: %s\n", message.c_str());
+  printf("Mensagem: %s\n", message);
   printf("RSSI: %d dBm\n", LoRa.packetRssi());
   printf("SNR: %.2f dB\n", LoRa.packetSnr());
   
@@ -140,9 +102,10 @@ void onReceive(int packetSize) {
   LoRa.receive();
 }
 
-// Callback quando a transmissão for concluída
+// Callback quando a fila de transmissão esvaziar
 void onTxDone() {
-  printf("Transmissão concluída!\n");
+  printf("Fila de TX vazia!\n");
+  printLbtStats();
   // Voltar ao modo de recepção após transmitir
   LoRa.receive();
 }
@@ -153,6 +116,10 @@ int main() {
   
   printf("\nIniciando Exemplo LoRa CAD (Channel Activity Detection)...\n");
   
+  // Informar ao picotool os pinos usados por este exemplo
+  bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
+  bi_decl(bi_3pins_with_names(csPin, "LoRa CS", resetPin, "LoRa RESET", irqPin, "LoRa DIO0"));
+  
   // Configurar pinos do LoRa
   LoRa.setPins(csPin, resetPin, irqPin);
   
@@ -171,10 +138,17 @@ int main() {
   LoRa.setSyncWord(syncWord);
   LoRa.enableCrc();
   
+  // Configurar o acesso ao canal
+  LoRaLbtConfig lbt;
+  lbt.maxAttempts = maxCadAttempts;
+  lbt.minExponent = minBackoffExp;
+  lbt.maxExponent = maxBackoffExp;
+  lbt.rssiThreshold = rssiThreshold;
+  LoRa.enableLbt(lbt);
+  
   // Configurar callbacks
   LoRa.onReceive(onReceive);
   LoRa.onTxDone(onTxDone);
-  LoRa.onCadDone(onCadDone);
   
   printf("Inicialização do LoRa concluída com sucesso!\n");
   printf("Configuração:\n");
@@ -186,6 +160,8 @@ int main() {
   printf("- Comprimento do Preâmbulo: %d\n", preambleLength);
   printf("- Palavra de Sincronização: 0x%02X\n", syncWord);
   printf("- Máximo de tentativas CAD: %d\n", maxCadAttempts);
+  printf("- Janela de backoff: 2^%d a 2^%d slots de 2 símbolos\n", minBackoffExp, maxBackoffExp);
+  printf("- Limiar de RSSI: %d dBm\n", rssiThreshold);
   
   // Iniciar em modo de recepção
   LoRa.receive();
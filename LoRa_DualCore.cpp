@@ -0,0 +1,116 @@
+/*
+  LoRa DualCore - Rádio LoRa rodando no core1
+
+  Este código usa o LoRaEngine para executar o driver do rádio no core1.
+  O core0 fica livre para a aplicação e conversa com o rádio apenas por
+  filas sem travas: enviar um pacote é só colocá-lo na fila de TX, e os
+  pacotes recebidos e eventos (TxDone, RxDone) chegam por outras filas.
+  Utiliza a biblioteca pico-lora para Raspberry Pi Pico com módulo RFM95W.
+
+  Conexões:
+  - CS: GPIO 8
+  - RESET: GPIO 9
+  - DIO0/IRQ: GPIO 7
+  - MISO: GPIO 16
+  - MOSI: GPIO 19
+  - SCK: GPIO 18
+*/
+
+#include "stdlib.h"
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "stdio.h"
+#include "string.h"
+
+// Incluir biblioteca LoRa e o motor do core1
+#include "Lora-RP2040.h"
+#include "LoRa-Engine.h"
+
+// Parâmetros de configuração LoRa
+const long frequency = 915E6;       // Frequência em Hz (915MHz)
+const int spreadingFactor = 7;      // Fator de espalhamento (7-12)
+const long signalBandwidth = 125E3; // Largura de banda (Hz)
+const int codingRate = 5;           // Taxa de codificação (5-8 para 4/5 até 4/8)
+const int syncWord = 0x34;          // Palavra de sincronização (0x34 é o padrão)
+
+const int interval = 1000;          // Intervalo entre envios (ms)
+
+// Motor de rádio sobre a instância global LoRa
+LoRaEngine engine(LoRa);
+
+int main() {
+  // Inicializar stdio
+  stdio_init_all();
+
+  printf("\nIniciando LoRa com o rádio no core1...\n");
+
+  // Informar ao picotool os pinos usados por este exemplo
+  bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
+  bi_decl(bi_3pins_with_names(8, "LoRa CS", 9, "LoRa RESET", 7, "LoRa DIO0"));
+
+  // Configurar o rádio no core0, antes de iniciar o motor
+  LoRa.setPins(8, 9, 7);
+
+  if (!LoRa.begin(frequency)) {
+    printf("Falha na inicialização do LoRa. Verifique as conexões.\n");
+    while (true);  // Se falhar, não continua
+  }
+
+  LoRa.setSpreadingFactor(spreadingFactor);
+  LoRa.setSignalBandwidth(signalBandwidth);
+  LoRa.setCodingRate4(codingRate);
+  LoRa.setSyncWord(syncWord);
+  LoRa.enableCrc();
+
+  // A partir daqui o core0 não acessa mais o rádio diretamente
+  engine.start();
+  printf("Motor de rádio iniciado no core1.\n\n");
+
+  uint32_t msgCount = 0;
+  uint32_t lastSendTime = 0;
+  uint32_t reportedDrops = 0;
+  LoRaEngineFrame frame;
+  LoRaEngineEvent event;
+
+  // Loop principal
+  while (true) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+
+    // Enfileirar telemetria, sem esperar pelo rádio
+    if (now - lastSendTime > interval) {
+      char message[32];
+      int length = snprintf(message, sizeof(message), "Telemetria #%lu", (unsigned long)msgCount++);
+
+      if (!engine.send((const uint8_t *)message, length)) {
+        printf("Fila de TX cheia, mensagem descartada\n");
+      }
+      lastSendTime = now;
+    }
+
+    // Pacotes recebidos pelo core1
+    while (engine.receive(frame)) {
+      printf("Recebido (%d bytes): %.*s | RSSI: %d dBm | SNR: %.2f dB\n",
+             frame.length, frame.length, (const char *)frame.data, frame.rssi, frame.snr);
+    }
+
+    // Eventos do rádio
+    while (engine.pollEvent(event)) {
+      if (event.type == LORA_EVENT_TX_DONE) {
+        printf("TX concluído em %llu us\n", (unsigned long long)event.timestamp);
+      }
+    }
+
+    // Estado das filas, impresso quando houver novos descartes
+    if (engine.txDropped() + engine.rxDropped() != reportedDrops) {
+      reportedDrops = engine.txDropped() + engine.rxDropped();
+      printf("Descartes: TX=%lu RX=%lu (filas: TX=%u RX=%u)\n",
+             (unsigned long)engine.txDropped(), (unsigned long)engine.rxDropped(),
+             (unsigned)engine.txDepth(), (unsigned)engine.rxDepth());
+    }
+
+    // Trabalho da aplicação no core0
+    sleep_ms(10);
+  }
+
+  return 0;
+}
@@ -2,7 +2,8 @@
   LoRa Duplex - Exemplo de comunicação bidirecional LoRa
   
   Este código configura um módulo LoRa para comunicação bidirecional (duplex),
-  permitindo que o dispositivo envie e receba mensagens.
+  permitindo que o dispositivo envie e receba mensagens de telemetria em
+  formato binário compacto (LoRa-Frame.h) em vez de texto.
   Utiliza a biblioteca pico-lora para Raspberry Pi Pico com módulo RFM95W.
   
   Conexões:
@@ -19,16 +20,15 @@
 #include "pico/binary_info.h"
 #include "stdio.h"
 #include "string.h"
-#include <string>
 
-// Incluir biblioteca LoRa
+// Incluir biblioteca LoRa e o enquadramento binário
 #include "Lora-RP2040.h"
+#include "LoRa-Frame.h"
+#include "LoRa-TimeOnAir.h"
 
 // Definir o tipo byte como uint8_t
 typedef uint8_t byte;
 
-using std::string;
-
 // Definir pinos para o módulo LoRa
 const int csPin = 8;          // LoRa radio chip select
 const int resetPin = 9;       // LoRa radio reset
@@ -47,32 +47,50 @@ const int syncWord = 0x34;     // Palavra de sincronização (0x34 é o padrão)
 const byte localAddress = 0xBB;     // Endereço deste dispositivo
 const byte destinationAddress = 0xAA; // Endereço do dispositivo de destino
 
+// Cabeçalho: endereços de 8 bits, 2 flags e sequência de 6 bits em 3 bytes.
+// O comprimento não vai no cabeçalho, o rádio já o informa.
+constexpr LoRaHeaderLayout headerLayout = { 8, 2, 6 };
+
+// Telemetria: tempo ligado (s), RSSI (dBm) e SNR (x4) do último pacote
+// ouvido e total de pacotes recebidos, todos como varint
+typedef LoRaMessage<LoRaVarint<uint32_t>, LoRaVarint<int16_t>, LoRaVarint<int16_t>, LoRaVarint<uint16_t>> Telemetry;
+
+static_assert(headerLayout.size() + Telemetry::maxSize <= LORA_TX_FIFO_SIZE, "a telemetria cabe na fila de TX");
+
+// Pior caso do tempo no ar, conhecido em tempo de compilação
+constexpr uint32_t telemetryAirtime = loraTimeOnAirUs(headerLayout.size() + Telemetry::maxSize, spreadingFactor,
+                                                      signalBandwidth, codingRate, preambleLength);
+
 // Variáveis para controle de envio
 uint8_t msgCount = 0;          // Contador de mensagens enviadas
 int interval = 2000;           // Intervalo entre envios (ms)
 long lastSendTime = 0;         // Timestamp do último envio
 
-// Função para enviar mensagem
-void sendMessage(string message) {
-  // Colocar o rádio em modo de transmissão
-  LoRa.idle();
-  
-  // Iniciar pacote
-  LoRa.beginPacket();
+// Qualidade do último pacote ouvido, atualizada na interrupção
+volatile int16_t lastRssi = 0;
+volatile int16_t lastSnr = 0;   // em quartos de dB
+volatile uint16_t receivedCount = 0;
+
+// Função para enviar a telemetria
+void sendTelemetry() {
+  // Montar o quadro direto na posição livre da fila de TX, sem cópia
+  uint8_t *frame = LoRa.reserveTx();
+  if (!frame) {
+    printf("Fila de TX cheia, telemetria descartada.\n");
+    return;
+  }
   
-  // Adicionar cabeçalho
-  LoRa.write(destinationAddress);  // Endereço de destino
-  LoRa.write(localAddress);        // Endereço do remetente
-  LoRa.write(msgCount);            // ID da mensagem
-  LoRa.write(message.length());    // Comprimento do payload
+  LoRaFrameWriter writer(frame, LORA_TX_FIFO_SIZE);
+  uint32_t uptime = to_ms_since_boot(get_absolute_time()) / 1000;
   
-  // Adicionar payload
-  LoRa.print(message.c_str());
+  writer.header(headerLayout, { destinationAddress, localAddress, 0, msgCount });
+  Telemetry::write(writer, uptime, (int16_t)lastRssi, (int16_t)lastSnr, (uint16_t)receivedCount);
   
-  // Finalizar e enviar pacote
-  LoRa.endPacket(true);  // true para envio assíncrono
+  // Enviar; o rádio volta a receber quando a fila esvaziar
+  LoRa.commitTx(writer.length());
   
-  printf("Mensagem enviada para 0x%02X: %s\n", destinationAddress, message.c_str());
+  printf("Telemetria enviada para 0x%02X: %u bytes (tempo ligado %lu s)\n",
+         destinationAddress, (unsigned)writer.length(), (unsigned long)uptime);
 }
 
 // Função para processar pacotes recebidos
@@ -80,39 +98,40 @@ void onReceive(int packetSize) {
   // Ignorar pacotes vazios
   if (packetSize == 0) return;
   
-  // Ler cabeçalho
-  byte recipient = LoRa.read();      // Endereço de destino
-  byte sender = LoRa.read();         // Endereço do remetente
-  byte incomingMsgId = LoRa.read();  // ID da mensagem
-  byte incomingLength = LoRa.read(); // Comprimento do payload
+  // Ler o pacote da FIFO em uma única rajada
+  uint8_t packet[256];
+  int packetLength = LoRa.readPacket(packet, sizeof(packet));
   
-  // Criar buffer para a mensagem
-  string message = "";
-  
-  // Ler payload
-  while (LoRa.available()) {
-    message += (char)LoRa.read();
-  }
+  // Decodificar cabeçalho e campos; cada leitura confere os limites do pacote
+  LoRaFrameReader reader(packet, packetLength);
+  LoRaHeader header;
+  uint32_t uptime;
+  int16_t rssi, snr;
+  uint16_t count;
   
-  // Verificar se o comprimento está correto
-  if (incomingLength != message.length()) {
-    printf("Erro: comprimento da mensagem não corresponde.\n");
+  if (!reader.header(headerLayout, header) || !Telemetry::read(reader, uptime, rssi, snr, count)) {
+    printf("Erro: pacote curto ou malformado (%d bytes).\n", packetLength);
     return;
   }
   
   // Verificar se a mensagem é para este dispositivo
-  if (recipient != localAddress && recipient != 0xFF) {
+  if (header.destination != localAddress && header.destination != headerLayout.broadcast()) {
     printf("Mensagem não é para este dispositivo.\n");
     return;
   }
   
+  lastRssi = LoRa.packetRssi();
+  lastSnr = (int16_t)(LoRa.packetSnr() * 4);
+  receivedCount++;
+  
   // Exibir informações do pacote recebido
-  printf("\nPacote recebido de: 0x%02X\n", sender);
-  printf("ID da mensagem: %d\n", incomingMsgId);
-  printf("Comprimento: %d\n", incomingLength);
-  printf("Mensagem: %s\n", message.c_str());
-  printf("RSSI: %d dBm\n", LoRa.packetRssi());
-  printf("SNR: %.2f dB\n", LoRa.packetSnr());
+  printf("\nTelemetria recebida de: 0x%02X\n", header.source);
+  printf("ID da mensagem: %d\n", header.sequence);
+  printf("Comprimento: %d bytes\n", packetLength);
+  printf("Tempo ligado do remetente: %lu s\n", (unsigned long)uptime);
+  printf("Como o remetente nos ouve: RSSI %d dBm, SNR %.2f dB, %u pacotes\n", rssi, snr / 4.0f, count);
+  printf("RSSI: %d dBm\n", lastRssi);
+  printf("SNR: %.2f dB\n", lastSnr / 4.0f);
   
   // Após receber, voltar ao modo de recepção
   LoRa.receive();
@@ -133,6 +152,10 @@ int main() {
   printf("Endereço local: 0x%02X\n", localAddress);
   printf("Endereço de destino: 0x%02X\n", destinationAddress);
   
+  // Informar ao picotool os pinos usados por este exemplo
+  bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
+  bi_decl(bi_3pins_with_names(csPin, "LoRa CS", resetPin, "LoRa RESET", irqPin, "LoRa DIO0"));
+  
   // Configurar pinos do LoRa
   LoRa.setPins(csPin, resetPin, irqPin);
   
@@ -164,6 +187,8 @@ int main() {
   printf("- Taxa de Codificação: 4/%d\n", codingRate);
   printf("- Comprimento do Preâmbulo: %d\n", preambleLength);
   printf("- Palavra de Sincronização: 0x%02X\n", syncWord);
+  printf("- Telemetria: até %u bytes, %lu us no ar\n",
+         (unsigned)(headerLayout.size() + Telemetry::maxSize), (unsigned long)telemetryAirtime);
   
   // Iniciar em modo de recepção
   LoRa.receive();
@@ -173,16 +198,8 @@ int main() {
   while (true) {
     // Verificar se é hora de enviar uma nova mensagem
     if (to_ms_since_boot(get_absolute_time()) - lastSendTime > interval) {
-      // Criar mensagem
-      string message = "Olá do dispositivo 0x";
-      char hexAddr[3];
-      sprintf(hexAddr, "%02X", localAddress);
-      message += hexAddr;
-      message += " - Msg #";
-      message += std::to_string(msgCount);
-      
-      // Enviar mensagem
-      sendMessage(message);
+      // Enviar telemetria
+      sendTelemetry();
       
       // Atualizar timestamp e contador
       lastSendTime = to_ms_since_boot(get_absolute_time());
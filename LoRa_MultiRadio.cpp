@@ -0,0 +1,135 @@
+/*
+  LoRa MultiRadio - Gateway de múltiplos canais com dois módulos RFM95W
+  
+  Este código usa duas instâncias de LoRaClass, cada uma com seu próprio
+  barramento SPI, pino CS e pino DIO0, para receber em duas frequências ao
+  mesmo tempo. As interrupções de DIO0 são despachadas para a instância
+  correta pelo número do GPIO. Os dois rádios também podem dividir um só
+  barramento, com CS próprios: cada acesso SPI segura uma trava do
+  barramento com as interrupções desligadas, então a ISR de um rádio nunca
+  corta uma rajada do outro.
+  Utiliza a biblioteca pico-lora para Raspberry Pi Pico com módulo RFM95W.
+  
+  Conexões do rádio 1 (spi0):
+  - CS: GPIO 8
+  - RESET: GPIO 9
+  - DIO0/IRQ: GPIO 7
+  - MISO: GPIO 16
+  - MOSI: GPIO 19
+  - SCK: GPIO 18
+  
+  Conexões do rádio 2 (spi1):
+  - CS: GPIO 13
+  - RESET: GPIO 14
+  - DIO0/IRQ: GPIO 15
+  - MISO: GPIO 12
+  - MOSI: GPIO 11
+  - SCK: GPIO 10
+*/
+
+#include "stdlib.h"
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "stdio.h"
+#include "string.h"
+
+// Incluir biblioteca LoRa
+#include "Lora-RP2040.h"
+
+// Segundo rádio, o primeiro é a instância global LoRa
+LoRaClass LoRa2;
+
+// Parâmetros de configuração LoRa
+const long frequency1 = 915E6;      // Frequência do rádio 1 (Hz)
+const long frequency2 = 916.8E6;    // Frequência do rádio 2 (Hz)
+const int spreadingFactor = 7;      // Fator de espalhamento (7-12)
+const long signalBandwidth = 125E3; // Largura de banda (Hz)
+const int codingRate = 5;           // Taxa de codificação (5-8 para 4/5 até 4/8)
+const int syncWord = 0x34;          // Palavra de sincronização (0x34 é o padrão)
+
+// Exibir um pacote recebido por um dos rádios
+void printPacket(LoRaClass &radio, int channel) {
+  char message[256];
+  int messageLength = radio.readPacket((uint8_t *)message, sizeof(message) - 1);
+  message[messageLength] = '\0';
+  
+  printf("\n[Canal %d] Pacote recebido:\n", channel);
+  printf("Mensagem: %s\n", message);
+  printf("RSSI: %d dBm\n", radio.packetRssi());
+  printf("SNR: %.2f dB\n", radio.packetSnr());
+}
+
+// Callbacks de recepção, um por rádio
+void onReceive1(int packetSize) {
+  if (packetSize == 0) return;
+  printPacket(LoRa, 1);
+}
+
+void onReceive2(int packetSize) {
+  if (packetSize == 0) return;
+  printPacket(LoRa2, 2);
+}
+
+// Aplicar os mesmos parâmetros de modulação a um rádio
+void configure(LoRaClass &radio) {
+  radio.setSpreadingFactor(spreadingFactor);
+  radio.setSignalBandwidth(signalBandwidth);
+  radio.setCodingRate4(codingRate);
+  radio.setSyncWord(syncWord);
+  radio.enableCrc();
+}
+
+int main() {
+  // Inicializar stdio
+  stdio_init_all();
+  
+  printf("\nIniciando Gateway LoRa com dois rádios...\n");
+  
+  // Informar ao picotool os pinos dos dois rádios
+  bi_decl(bi_3pins_with_func(16, 19, 18, GPIO_FUNC_SPI));
+  bi_decl(bi_3pins_with_names(8, "Rádio 1 CS", 9, "Rádio 1 RESET", 7, "Rádio 1 DIO0"));
+  bi_decl(bi_3pins_with_func(12, 11, 10, GPIO_FUNC_SPI));
+  bi_decl(bi_3pins_with_names(13, "Rádio 2 CS", 14, "Rádio 2 RESET", 15, "Rádio 2 DIO0"));
+  
+  // Rádio 1 em spi0
+  LoRa.setSPI(*spi0);
+  LoRa.setSPIPins(16, 18, 19);
+  LoRa.setPins(8, 9, 7);
+  
+  // Rádio 2 em spi1
+  LoRa2.setSPI(*spi1);
+  LoRa2.setSPIPins(12, 10, 11);
+  LoRa2.setPins(13, 14, 15);
+  
+  if (!LoRa.begin(frequency1)) {
+    printf("Falha na inicialização do rádio 1. Verifique as conexões.\n");
+    while (true);  // Se falhar, não continua
+  }
+  
+  if (!LoRa2.begin(frequency2)) {
+    printf("Falha na inicialização do rádio 2. Verifique as conexões.\n");
+    while (true);  // Se falhar, não continua
+  }
+  
+  configure(LoRa);
+  configure(LoRa2);
+  
+  // Cada rádio tem seu próprio callback
+  LoRa.onReceive(onReceive1);
+  LoRa2.onReceive(onReceive2);
+  
+  printf("Rádio 1: %ld Hz\n", frequency1);
+  printf("Rádio 2: %ld Hz\n", frequency2);
+  printf("\nAguardando pacotes nos dois canais...\n");
+  
+  // Os dois rádios recebem ao mesmo tempo
+  LoRa.receive();
+  LoRa2.receive();
+  
+  // Loop principal - apenas mantém o programa rodando
+  while (true) {
+    sleep_ms(100);  // Pequena pausa para economizar CPU
+  }
+  
+  return 0;
+}
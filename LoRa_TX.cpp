@@ -22,6 +22,7 @@
 
 // Incluir biblioteca LoRa
 #include "Lora-RP2040.h"
+#include "LoRa-Compress.h"
 
 using std::string;
 
@@ -39,6 +40,13 @@ const int codingRate = 5;      // Taxa de codificação (5-8 para 4/5 até 4/8)
 const int preambleLength = 8;  // Comprimento do preâmbulo
 const int syncWord = 0x34;     // Palavra de sincronização (0x34 é o padrão)
 
+// Dicionário pré-compartilhado - DEVE SER IGUAL AO DO RECEPTOR
+const char compressDictionary[] = "Transmissor LoRa - Mensagem #";
+
+// Compressão entre a aplicação e o rádio; receptores sem ela recebem
+// os pacotes que não encolhem normalmente, em texto puro
+LoRaCompressor compressor(LoRa);
+
 // Variáveis para controle de envio
 uint8_t msgCount = 0;          // Contador de mensagens enviadas
 int interval = 2000;           // Intervalo entre envios (ms)
@@ -51,15 +59,16 @@ void sendMessage(string message) {
   LoRa.disableInvertIQ();      // Modo normal para transmissão
   
   // Iniciar pacote
-  LoRa.beginPacket();
+  compressor.beginPacket();
   
   // Adicionar payload
-  LoRa.print(message.c_str());
+  compressor.print(message.c_str());
   
-  // Finalizar e enviar pacote
-  LoRa.endPacket(true);  // true para envio assíncrono
+  // Comprimir, finalizar e enviar pacote
+  compressor.endPacket(true);  // true para envio assíncrono
   
-  printf("Mensagem enviada: %s\n", message.c_str());
+  printf("Mensagem enviada: %s (%lu de %lu bytes no ar)\n", message.c_str(),
+         (unsigned long)compressor.stats().bytesOut, (unsigned long)compressor.stats().bytesIn);
 }
 
 // Callback quando a transmissão for concluída
@@ -73,6 +82,10 @@ int main() {
   
   printf("\nIniciando Transmissor LoRa...\n");
   
+  // Informar ao picotool os pinos usados por este exemplo
+  bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
+  bi_decl(bi_3pins_with_names(csPin, "LoRa CS", resetPin, "LoRa RESET", irqPin, "LoRa DIO0"));
+  
   // Configurar pinos do LoRa
   LoRa.setPins(csPin, resetPin, irqPin);
   
@@ -91,6 +104,13 @@ int main() {
   LoRa.setSyncWord(syncWord);
   LoRa.enableCrc();
   
+  // Respeitar o ciclo de trabalho das sub-bandas EU868 (1%/0,1%); em 915 MHz
+  // nenhuma sub-banda se aplica e os envios não são limitados
+  LoRa.setDutyCycle(LORA_EU868_SUB_BANDS, LORA_EU868_SUB_BAND_COUNT);
+  
+  // Carregar o dicionário usado pela compressão
+  compressor.setDictionary((const uint8_t *)compressDictionary, strlen(compressDictionary));
+  
   // Configurar callback para quando a transmissão for concluída
   LoRa.onTxDone(onTxDone);
   
@@ -113,6 +133,14 @@ int main() {
       string message = "Transmissor LoRa - Mensagem #";
       message += std::to_string(msgCount);
       
+      // Sem orçamento de tempo no ar, esperar até quando o rádio puder enviar
+      if (!LoRa.canSend(message.length())) {
+        uint64_t next = LoRa.nextSendTime(message.length());
+        printf("Ciclo de trabalho esgotado, próximo envio em %llu ms\n",
+               (unsigned long long)((next - time_us_64()) / 1000));
+        sleep_until(from_us_since_boot(next));
+      }
+      
       // Enviar mensagem
       sendMessage(message);
       
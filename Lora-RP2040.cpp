@@ -1,6 +1,9 @@
 #include "Lora-RP2040.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 
 // registers
 #define REG_FIFO                 0x00
@@ -10,6 +13,7 @@
 #define REG_FRF_LSB              0x08
 #define REG_PA_CONFIG            0x09
 #define IRQ_CAD_DETECTED_MASK    0x01
+#define IRQ_FHSS_CHANGE_MASK     0x02
 #define REG_OCP                  0x0b
 #define REG_LNA                  0x0c
 #define IRQ_CAD_DONE_MASK        0x04
@@ -19,14 +23,19 @@
 #define REG_FIFO_RX_CURRENT_ADDR 0x10
 #define REG_IRQ_FLAGS            0x12
 #define REG_RX_NB_BYTES          0x13
+#define REG_MODEM_STAT           0x18
 #define REG_PKT_SNR_VALUE        0x19
 #define REG_PKT_RSSI_VALUE       0x1a
 #define REG_RSSI_VALUE           0x1b
+#define REG_HOP_CHANNEL          0x1c
 #define REG_MODEM_CONFIG_1       0x1d
 #define REG_MODEM_CONFIG_2       0x1e
+#define REG_SYMB_TIMEOUT         0x1f
 #define REG_PREAMBLE_MSB         0x20
 #define REG_PREAMBLE_LSB         0x21
 #define REG_PAYLOAD_LENGTH       0x22
+#define REG_HOP_PERIOD           0x24
+#define REG_FIFO_RX_BYTE_ADDR    0x25
 #define REG_MODEM_CONFIG_3       0x26
 #define REG_FREQ_ERROR_MSB       0x28
 #define REG_FREQ_ERROR_MID       0x29
@@ -54,8 +63,10 @@
 
 // IRQ masks
 #define IRQ_TX_DONE_MASK           0x08
+#define IRQ_VALID_HEADER_MASK      0x10
 #define IRQ_PAYLOAD_CRC_ERROR_MASK 0x20
 #define IRQ_RX_DONE_MASK           0x40
+#define IRQ_RX_TIMEOUT_MASK        0x80
 
 #define RF_MID_BAND_THRESHOLD    525E6
 #define RSSI_OFFSET_HF_PORT      157
@@ -63,23 +74,99 @@
 
 #define MAX_PKT_LENGTH           255
 
+// slack on top of the computed duration before a blocking wait on DIO0 gives up
+#define IRQ_TIMEOUT_MARGIN_US    2000
+
+// listen-before-talk states, and how long RX runs before the RSSI check
+#define LBT_IDLE                 0
+#define LBT_CAD                  1
+#define LBT_RSSI                 2
+#define LBT_BACKOFF              3
+#define LBT_RSSI_SETTLE_US       1000
+
+// FIFO split, see LORA_TX_FIFO_SIZE
+#define FIFO_TX_BASE             0x80
+#define FIFO_RX_BASE             0x00
+
 #if (ESP8266 || ESP32)
 #define ISR_PREFIX ICACHE_RAM_ATTR
 #else
 #define ISR_PREFIX
 #endif
 
+static void frequencyToFrf(long frequency, uint8_t *frf)
+{
+  uint64_t value = ((uint64_t)frequency << 19) / 32000000;
+
+  frf[0] = (uint8_t)(value >> 16);
+  frf[1] = (uint8_t)(value >> 8);
+  frf[2] = (uint8_t)(value >> 0);
+}
+
 LoRaClass::LoRaClass() : 
-      _spi(SPI_PORT),
-      _ss(LORA_DEFAULT_SS_PIN), _reset(LORA_DEFAULT_RESET_PIN), _dio0(LORA_DEFAULT_DIO0_PIN), 
+      _spi(LORA_DEFAULT_SPI),
+      _ss(LORA_DEFAULT_SS_PIN), _reset(LORA_DEFAULT_RESET_PIN), _dio0(LORA_DEFAULT_DIO0_PIN), _dio1(LORA_DEFAULT_DIO1_PIN), 
+      _miso(PIN_MISO), _sck(PIN_SCK), _mosi(PIN_MOSI), 
       _frequency(0), 
       _packetIndex(0),
+      _packetLength(0),
+      _payloadLength(0),
       _implicitHeaderMode(0), 
+      _fixedLength(0),
+      _modemConfig1(0),
+      _modemConfig2(0),
+      _modemConfig3(0),
+      _lna(0),
+      _preambleLength(8),
+      _packetInfo(),
       _onReceive(NULL), 
       _onCadDone(NULL),
-      _onTxDone(NULL) 
+      _onTxDone(NULL),
+      _onRxTimeout(NULL),
+      _rxTimeoutDeadline(0),
+      _deferredIrq(false),
+      _irqTime(0),
+      _irqOverflow(false),
+      _irqOverflows(0),
+      _packetPoolEnabled(false),
+      _streamingRx(false),
+      _streamActive(false),
+      _streamSlab(NULL),
+      _streamStart(0),
+      _streamCopied(0),
+      _streamDeadline(0),
+      _streamFallbacks(0),
+      _txQueueActive(false),
+      _txResumeRx(false),
+      _txBlockedUntil(0),
+      _lbtEnabled(false),
+      _lbtStats(),
+      _lbtState(LBT_IDLE),
+      _lbtAttempt(0),
+      _lbtClear(false),
+      _lbtDue(false),
+      _lbtSeed(0),
+      _dio0Waiting(false),
+      _dio0Edge(false),
+      _dio1Mapping(0),
+      _fhssChannels(0),
+      _scanChannels(0),
+      _scanStatsCount(0),
+      _scanIndex(0),
+      _dmaTx(-1),
+      _dmaRx(-1),
+      _dmaActive(false),
+      _dmaReadLength(0),
+      _dmaDummy(0),
+      _onTransferDone(NULL) 
 {}
 
+LoRaClass *LoRaClass::_dioInstances[NUM_BANK0_GPIOS];
+LoRaClass *LoRaClass::_dmaInstances[NUM_DMA_CHANNELS];
+bool LoRaClass::_dmaIrqInstalled = false;
+spin_lock_t *LoRaClass::_busLocks[NUM_SPIS];
+LoRaClass *LoRaClass::_busDma[NUM_SPIS];
+
 int LoRaClass::begin(long frequency) 
 {
 
@@ -101,22 +188,19 @@ int LoRaClass::begin(long frequency)
   }
 
 
-  // start SPI
-  spi_init(SPI_PORT, 12500);
-  gpio_set_function(PIN_MISO, GPIO_FUNC_SPI);
-  gpio_set_function(PIN_SCK, GPIO_FUNC_SPI);
-  gpio_set_function(PIN_MOSI, GPIO_FUNC_SPI);
-
-
-  // Make the SPI pins available to picotool
-  bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
+  // radios on the same bus take turns through one lock
+  uint bus = spi_get_index(_spi);
+  if (!_busLocks[bus]) {
+    _busLocks[bus] = spin_lock_instance(spin_lock_claim_unused(true));
+  }
 
-  gpio_init(PIN_CS);
-  gpio_set_dir(PIN_CS, GPIO_OUT);
-  gpio_put(PIN_CS, 1);
+  // start SPI
+  spi_init(_spi, 12500);
+  gpio_set_function(_miso, GPIO_FUNC_SPI);
+  gpio_set_function(_sck, GPIO_FUNC_SPI);
+  gpio_set_function(_mosi, GPIO_FUNC_SPI);
 
-  // Make the CS pin available to picotool
-  bi_decl(bi_1pin_with_name(PIN_CS, "SPI CS"));
+  // pins are chosen at runtime, the examples declare theirs to picotool
 
   // check version
   uint8_t version = readRegister(REG_VERSION);
@@ -127,18 +211,21 @@ int LoRaClass::begin(long frequency)
   // put in sleep mode
   sleep();
 
+  // load the register shadow from the freshly reset radio
+  resync();
+
   // set frequency
   setFrequency(frequency);
 
-  // set base addresses
-  writeRegister(REG_FIFO_TX_BASE_ADDR, 0);
-  writeRegister(REG_FIFO_RX_BASE_ADDR, 0);
+  // set base addresses, TX and RX get one half of the FIFO each
+  writeRegister(REG_FIFO_TX_BASE_ADDR, FIFO_TX_BASE);
+  writeRegister(REG_FIFO_RX_BASE_ADDR, FIFO_RX_BASE);
 
   // set LNA boost
-  writeRegister(REG_LNA, readRegister(REG_LNA) | 0x03);
+  updateRegister(REG_LNA, _lna, _lna | 0x03);
 
   // set auto AGC
-  writeRegister(REG_MODEM_CONFIG_3, 0x04);
+  updateRegister(REG_MODEM_CONFIG_3, _modemConfig3, 0x04);
 
   // set output power to 17 dBm
   setTxPower(17);
@@ -154,8 +241,11 @@ void LoRaClass::end()
   // put in sleep mode
   sleep();
 
+  // release DMA channels, if any
+  disableDma();
+
   // stop SPI
-  spi_deinit(SPI_PORT);
+  spi_deinit(_spi);
 }
 
 int LoRaClass::beginPacket(int implicitHeader) 
@@ -167,195 +257,1289 @@ int LoRaClass::beginPacket(int implicitHeader)
   // put in standby mode
   idle();
 
-  if (implicitHeader) {
+  if (implicitHeader || _fixedLength) {
     implicitHeaderMode();
   } else {
     explicitHeaderMode();
   }
 
-  // reset FIFO address and paload length
-  writeRegister(REG_FIFO_ADDR_PTR, 0);
-  writeRegister(REG_PAYLOAD_LENGTH, 0);
+  // reset FIFO address and paload length, frames longer than the TX half
+  // wrap into the RX half, which is fine outside RX
+  writeRegister(REG_FIFO_ADDR_PTR, FIFO_TX_BASE);
+  _payloadLength = 0;
+
+  return 1;
+}
+
+int LoRaClass::endPacket(bool async) 
+{
+
+  // a blocking send sleeps until the TxDone edge on DIO0
+  if (!async || _onTxDone || _fhssChannels)
+    writeRegister(REG_DIO_MAPPING_1, 0x40 | _dio1Mapping); // DIO0 => TXDONE
+
+  if (_fixedLength) {
+    // the radio sends the programmed length whatever was written
+    _payloadLength = _fixedLength;
+  }
+
+  if (!takeAirtime(_payloadLength)) {
+    return 0;
+  }
+
+  // payload length is tracked in software while writing, commit it once
+  if (!_fixedLength) {
+    writeRegister(REG_PAYLOAD_LENGTH, _payloadLength);
+  }
+
+  if (!async) {
+    return transmitBlocking();
+  }
+
+  // put in TX mode
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_TX);
+
+  return 1;
+}
+
+int LoRaClass::transmitBlocking() 
+{
+  absolute_time_t deadline = make_timeout_time_us(timeOnAir(_payloadLength) + IRQ_TIMEOUT_MARGIN_US);
+
+  armDio0Wait();
+
+  // put in TX mode
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_TX);
+
+  bool done = waitDio0(deadline);
+
+  disarmDio0Wait();
+
+  if (!done) {
+    // TxDone never came, do not leave the radio stuck in TX
+    idle();
+    return 0;
+  }
+
+  // clear IRQ's
+  writeRegister(REG_IRQ_FLAGS, IRQ_TX_DONE_MASK);
+
+  return 1;
+}
+
+void LoRaClass::armDio0Wait() 
+{
+  // the ISR only flags the edge and wakes us, no SPI while we wait
+  _dio0Edge = false;
+  _dio0Waiting = true;
+  _dioInstances[_dio0] = this;
+  gpio_set_irq_enabled_with_callback(_dio0, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
+}
+
+bool LoRaClass::waitDio0(absolute_time_t deadline) 
+{
+  while (!_dio0Edge) {
+    if (best_effort_wfe_or_timeout(deadline)) {
+      break;
+    }
+  }
+
+  // a level that was already high counts too
+  bool edge = _dio0Edge || gpio_get(_dio0);
+  _dio0Edge = false;
+
+  return edge;
+}
+
+void LoRaClass::disarmDio0Wait() 
+{
+  _dio0Waiting = false;
+
+  if (!dio0InUse()) {
+    gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
+  }
+}
+
+int LoRaClass::receiveLowPower(uint32_t intervalUs, uint64_t timeoutUs) 
+{
+  uint64_t end = timeoutUs ? time_us_64() + timeoutUs : UINT64_MAX;
+  uint64_t sample = time_us_64();
+  uint32_t symbol = symbolTime();
+  int packetLength = 0;
+
+  setSymbolTimeout(LORA_CAD_SYMBOL_TIMEOUT);
+  armDio0Wait();
+
+  while (sample < end) {
+    sleep_until(from_us_since_boot(sample));
+    sample += intervalUs;
+
+    // CAD takes about two symbols
+    writeRegister(REG_DIO_MAPPING_1, 0x80 | _dio1Mapping); // DIO0 => CADDONE
+    writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_CAD);
+
+    bool done = waitDio0(make_timeout_time_us(2 * symbol + IRQ_TIMEOUT_MARGIN_US));
+    int irqFlags = readRegister(REG_IRQ_FLAGS);
+
+    // clear IRQ's
+    writeRegister(REG_IRQ_FLAGS, irqFlags);
+
+    if (done && (irqFlags & IRQ_CAD_DETECTED_MASK) != 0) {
+      packetLength = receiveAfterCad();
+
+      if (packetLength > 0) {
+        break;
+      }
+
+      // a false detection or a bad frame may have run past the next sample
+      if (sample < time_us_64()) {
+        sample = time_us_64();
+      }
+    }
+
+    // the radio draws next to nothing until the next sample
+    sleep();
+  }
+
+  disarmDio0Wait();
+
+  return packetLength;
+}
+
+int LoRaClass::receiveAfterCad() 
+{
+  uint32_t symbol = symbolTime();
+
+  // stay on the channel, RX_SINGLE gives up by itself if there is no frame
+  writeRegister(REG_DIO_MAPPING_1, 0x00 | _dio1Mapping); // DIO0 => RXDONE
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_RX_SINGLE);
+
+  // RxTimeout has no DIO0 mapping, look at the flags once the window is over
+  if (!waitDio0(make_timeout_time_us((LORA_CAD_SYMBOL_TIMEOUT + 1) * symbol))) {
+    if (readRegister(REG_IRQ_FLAGS) & IRQ_RX_TIMEOUT_MASK) {
+      writeRegister(REG_IRQ_FLAGS, IRQ_RX_TIMEOUT_MASK);
+      return 0;
+    }
+
+    // preamble locked, the frame is still coming in
+    if (!waitDio0(make_timeout_time_us(timeOnAir(MAX_PKT_LENGTH) + IRQ_TIMEOUT_MARGIN_US))) {
+      idle();
+      return 0;
+    }
+  }
+
+  int irqFlags = readRegister(REG_IRQ_FLAGS);
+
+  // clear IRQ's
+  writeRegister(REG_IRQ_FLAGS, irqFlags);
+
+  if ((irqFlags & IRQ_RX_DONE_MASK) == 0 || (irqFlags & IRQ_PAYLOAD_CRC_ERROR_MASK) != 0) {
+    return 0;
+  }
+
+  // back in standby with the frame in the FIFO, same state as parsePacket()
+  _packetIndex = 0;
+
+  int rxAddress = capturePacketInfo(time_us_64());
+  _packetLength = _packetInfo.length;
+
+  writeRegister(REG_FIFO_ADDR_PTR, rxAddress);
+
+  return _packetLength;
+}
+
+void LoRaClass::setWakePreamble(uint32_t intervalUs) 
+{
+  setPreambleLength(loraWakePreamble(intervalUs, getSpreadingFactor(), getSignalBandwidth()));
+}
+
+bool LoRaClass::takeAirtime(size_t length) 
+{
+  uint32_t airtime = timeOnAir(length);
+  uint64_t now = time_us_64();
+
+  if (!_dutyCycle.canSend(_frequency, airtime, now)) {
+    return false;
+  }
+  _dutyCycle.charge(_frequency, airtime, now);
+
+  return true;
+}
+
+int LoRaClass::setFixedFrame(size_t length) 
+{
+  if (length == 0 || length > MAX_PKT_LENGTH) {
+    return 0;
+  }
+
+  implicitHeaderMode();
+  writeRegister(REG_PAYLOAD_LENGTH, length);
+  _fixedLength = length;
+
+  return 1;
+}
+
+void LoRaClass::disableFixedFrame() 
+{
+  _fixedLength = 0;
+  explicitHeaderMode();
+}
+
+int LoRaClass::sendFixed(const uint8_t *buffer, bool async) 
+{
+  if (!_fixedLength || _txQueueActive || !takeAirtime(_fixedLength)) {
+    return 0;
+  }
+
+  // header mode and payload length are already in the radio
+  idle();
+  writeRegister(REG_FIFO_ADDR_PTR, FIFO_TX_BASE);
+  burstWrite(REG_FIFO, buffer, _fixedLength);
+  _payloadLength = _fixedLength;
+
+  if (!async || _onTxDone || _fhssChannels)
+    writeRegister(REG_DIO_MAPPING_1, 0x40 | _dio1Mapping); // DIO0 => TXDONE
+
+  if (!async) {
+    return transmitBlocking();
+  }
+
+  // put in TX mode
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_TX);
+
+  return 1;
+}
+
+int LoRaClass::enableFhss(const long *channels, size_t count, uint8_t hopPeriod) 
+{
+  if (_dio1 < 0 || count == 0 || count > LORA_FHSS_MAX_CHANNELS || hopPeriod == 0) {
+    return 0;
+  }
+
+  // work out every FRF now, the hop interrupt only copies three bytes
+  for (size_t i = 0; i < count; i++) {
+    frequencyToFrf(channels[i], _fhssFrf[i]);
+  }
+  _fhssChannels = count;
+  _frequency = channels[0];
+  fhssRewind();
+
+  writeRegister(REG_HOP_PERIOD, hopPeriod);
+
+  _dio1Mapping = 0x10; // DIO1 => FHSSCHANGECHANNEL
+  writeRegister(REG_DIO_MAPPING_1, (readRegister(REG_DIO_MAPPING_1) & 0xc0) | _dio1Mapping);
+
+  // both pins share the GPIO callback
+  _dioInstances[_dio0] = this;
+  _dioInstances[_dio1] = this;
+  gpio_set_irq_enabled_with_callback(_dio0, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
+  gpio_set_irq_enabled_with_callback(_dio1, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
+
+  return 1;
+}
+
+void LoRaClass::disableFhss() 
+{
+  if (!_fhssChannels) {
+    return;
+  }
+
+  gpio_set_irq_enabled(_dio1, GPIO_IRQ_EDGE_RISE, false);
+  _fhssChannels = 0;
+
+  writeRegister(REG_HOP_PERIOD, 0);
+
+  _dio1Mapping = 0;
+  writeRegister(REG_DIO_MAPPING_1, readRegister(REG_DIO_MAPPING_1) & 0xc0);
+
+  if (!dio0InUse()) {
+    gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
+  }
+}
+
+void LoRaClass::fhssRewind() 
+{
+  burstWrite(REG_FRF_MSB, _fhssFrf[0], 3);
+}
+
+int LoRaClass::startScan(const long *channels, size_t count) 
+{
+  if (count == 0 || count > LORA_SCAN_MAX_CHANNELS) {
+    return 0;
+  }
+
+  gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
+
+  for (size_t i = 0; i < count; i++) {
+    frequencyToFrf(channels[i], _scanFrf[i]);
+    memset(&_scanStats[i], 0, sizeof(_scanStats[i]));
+  }
+
+  // band for the RSSI offset and the duty cycle
+  _frequency = channels[0];
+  _scanChannels = count;
+  _scanStatsCount = count;
+  _scanIndex = count - 1;
+  _rxTimeoutDeadline = 0;
+
+  idle();
+  setSymbolTimeout(LORA_CAD_SYMBOL_TIMEOUT);
+  resumeScan();
+
+  _dioInstances[_dio0] = this;
+  gpio_set_irq_enabled_with_callback(_dio0, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
+
+  return 1;
+}
+
+const LoRaScanStats &LoRaClass::scanStats(size_t channel) 
+{
+  static const LoRaScanStats empty = {};
+
+  return channel < _scanStatsCount ? _scanStats[channel] : empty;
+}
+
+void LoRaClass::stopScan() 
+{
+  if (!_scanChannels) {
+    return;
+  }
+
+  gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
+
+  _scanChannels = 0;
+  _rxTimeoutDeadline = 0;
+
+  idle();
+  setFrequency(_frequency);
+
+  if (dio0InUse()) {
+    gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, true);
+  }
+}
+
+void LoRaClass::resumeScan() 
+{
+  writeRegister(REG_DIO_MAPPING_1, 0x80 | _dio1Mapping); // DIO0 => CADDONE
+  scanNext();
+}
+
+void LoRaClass::scanNext() 
+{
+  // DIO0 is already mapped to CadDone, a hop is one FRF burst and the mode
+  _scanIndex = (_scanIndex + 1) % _scanChannels;
+
+  burstWrite(REG_FRF_MSB, _scanFrf[_scanIndex], 3);
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_CAD);
+}
+
+void LoRaClass::scanCadDone(bool detected) 
+{
+  LoRaScanStats &stats = _scanStats[_scanIndex];
+
+  stats.cads++;
+
+  if (!detected) {
+    scanNext();
+    return;
+  }
+
+  stats.detected++;
+
+  // stay on this channel, RX_SINGLE gives up by itself if there is no frame
+  writeRegister(REG_DIO_MAPPING_1, 0x00 | _dio1Mapping); // DIO0 => RXDONE
+  armRxTimeout(LORA_CAD_SYMBOL_TIMEOUT);
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_RX_SINGLE);
+}
+
+void LoRaClass::armRxTimeout(int symbols) 
+{
+  if (_dio1 >= 0 && !_fhssChannels) {
+    // DIO1 is mapped to RxTimeout whenever FHSS does not need it
+    _rxTimeoutDeadline = 0;
+    _dioInstances[_dio1] = this;
+    gpio_set_irq_enabled_with_callback(_dio1, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
+  } else {
+    _rxTimeoutDeadline = time_us_64() + (symbols + 1) * symbolTime();
+  }
+}
+
+void LoRaClass::checkRxTimeout() 
+{
+  // no DIO line for RxTimeout; mask DIO0 so a RxDone cannot race us
+  gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
+
+  if (_rxTimeoutDeadline) {
+    if (readRegister(REG_IRQ_FLAGS) & IRQ_RX_TIMEOUT_MASK) {
+      // the radio is already back in standby
+      writeRegister(REG_IRQ_FLAGS, IRQ_RX_TIMEOUT_MASK);
+      handleRxTimeout();
+    } else {
+      // preamble locked, the frame is still coming in
+      _rxTimeoutDeadline = time_us_64() + LORA_CAD_SYMBOL_TIMEOUT * symbolTime();
+    }
+  }
+
+  if (dio0InUse()) {
+    gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, true);
+  }
+}
+
+void LoRaClass::handleRxTimeout() 
+{
+  _rxTimeoutDeadline = 0;
+
+  if (_scanChannels) {
+    // false detection, back to sweeping
+    resumeScan();
+  } else if (_onRxTimeout) {
+    _onRxTimeout();
+  }
+}
+
+void LoRaClass::setSymbolTimeout(int symbols) 
+{
+  // 10 bits, the two MSBs live in REG_MODEM_CONFIG_2
+  writeRegister(REG_SYMB_TIMEOUT, symbols & 0xff);
+  updateRegister(REG_MODEM_CONFIG_2, _modemConfig2, (_modemConfig2 & 0xfc) | ((symbols >> 8) & 0x03));
+}
+
+uint32_t LoRaClass::timeOnAir(size_t length) 
+{
+  // straight from the register shadow, no SPI
+  return loraTimeOnAirUs(length, getSpreadingFactor(), getSignalBandwidth(),
+                         ((_modemConfig1 >> 1) & 0x07) + 4, _preambleLength,
+                         (_modemConfig2 & 0x04) != 0, (_modemConfig1 & 0x01) != 0,
+                         (_modemConfig3 & 0x08) != 0);
+}
+
+uint32_t LoRaClass::symbolTime() 
+{
+  return loraSymbolTimeUs(getSpreadingFactor(), getSignalBandwidth());
+}
+
+void LoRaClass::setDutyCycle(const LoRaSubBand *subBands, size_t count, uint32_t periodSeconds) 
+{
+  _dutyCycle.begin(subBands, count, periodSeconds);
+}
+
+void LoRaClass::disableDutyCycle() 
+{
+  _dutyCycle.end();
+}
+
+bool LoRaClass::canSend(size_t length) 
+{
+  return _dutyCycle.canSend(_frequency, timeOnAir(length), time_us_64());
+}
+
+uint64_t LoRaClass::nextSendTime(size_t length) 
+{
+  return _dutyCycle.nextSendTime(_frequency, timeOnAir(length), time_us_64());
+}
+
+uint32_t LoRaClass::airtimeAvailable() 
+{
+  return _dutyCycle.available(_frequency, time_us_64());
+}
+
+void LoRaClass::drainPacket(int packetLength, int rxAddress) 
+{
+  LoRaPacketSlab *slab = _streamSlab;
+  size_t copied = 0;
+
+  if (_streamActive && _streamStart == rxAddress && _streamCopied <= (size_t)packetLength) {
+    // the head is already in the slab, only the tail is left
+    copied = _streamCopied;
+    writeRegister(REG_FIFO_ADDR_PTR, rxAddress + copied);
+  } else {
+    if (_streamActive) {
+      // the stream followed another frame, read this one whole
+      _streamFallbacks++;
+    }
+
+    if (!slab) {
+      slab = _packetPool.acquire();
+    }
+  }
+
+  _streamActive = false;
+  _streamSlab = NULL;
+
+  if (slab) {
+    // FIFO pointer is at the first byte not copied yet, read the rest in one burst
+    burstRead(REG_FIFO, slab->data + copied, packetLength - copied);
+    slab->info = _packetInfo;
+    _packetPool.publish(slab);
+  }
+
+  if (_onReceive) {
+    // the payload is still in the FIFO, onReceive can read() it as usual
+    writeRegister(REG_FIFO_ADDR_PTR, rxAddress);
+  } else {
+    // nobody reads the FIFO, the slab is the only copy
+    _packetIndex = _packetLength;
+  }
+}
+
+int LoRaClass::enqueue(const uint8_t *buffer, size_t size) 
+{
+  uint8_t *frame = reserveTx();
+
+  if (!frame || size > LORA_TX_FIFO_SIZE) {
+    return 0;
+  }
+
+  memcpy(frame, buffer, size);
+
+  return commitTx(size);
+}
+
+uint8_t *LoRaClass::reserveTx() 
+{
+  LoRaTxFrame *frame = _txQueue.reserve();
+
+  return frame ? frame->data : NULL;
+}
+
+int LoRaClass::commitTx(size_t size) 
+{
+  LoRaTxFrame *frame = _txQueue.reserve();
+
+  if (!frame || size > LORA_TX_FIFO_SIZE || (_fixedLength && size != _fixedLength)) {
+    return 0;
+  }
+
+  frame->length = size;
+  _txQueue.commit();
+
+  if (!_txQueueActive) {
+    kickTxQueue();
+  }
+
+  return 1;
+}
+
+void LoRaClass::kickTxQueue() 
+{
+  // the TxDone path owns the queue while a frame is on air; mask DIO0 so a
+  // RxDone cannot interleave with this SPI work, edges stay latched
+  gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
+
+  if (!_txQueueActive) {
+    if (!_txResumeRx) {
+      _txResumeRx = readRegister(REG_OP_MODE) == (MODE_LONG_RANGE_MODE | MODE_RX_CONTINUOUS);
+    }
+    serviceTxQueue();
+  }
+
+  _dioInstances[_dio0] = this;
+  gpio_set_irq_enabled_with_callback(_dio0, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
+}
+
+void LoRaClass::serviceTxQueue() 
+{
+  LoRaTxFrame *frame = _txQueue.peek();
+  uint32_t airtime = frame ? timeOnAir(frame->length) : 0;
+  uint64_t now = time_us_64();
+
+  _txBlockedUntil = 0;
+
+  if (frame && !_dutyCycle.canSend(_frequency, airtime, now)) {
+    // out of budget, poll() retries once enough airtime has built up
+    _txBlockedUntil = _dutyCycle.nextSendTime(_frequency, airtime, now);
+  }
+
+  if (!frame || _txBlockedUntil) {
+    // listen while there is nothing to send or while waiting
+    _lbtClear = false;
+    if (_txResumeRx) {
+      _txResumeRx = frame != NULL;
+      receive();
+    }
+    return;
+  }
+
+  if (_lbtEnabled && !_lbtClear) {
+    // channel access first, lbtResult() comes back here once it is clear
+    _txQueueActive = true;
+    lbtCad();
+    return;
+  }
+
+  _lbtClear = false;
+  _dutyCycle.charge(_frequency, airtime, now);
+
+  // the FIFO can only be filled in standby, which ends any reception in
+  // progress; the frame goes to the TX half so the RX half keeps a packet
+  // not read yet
+  idle();
+  writeRegister(REG_FIFO_ADDR_PTR, FIFO_TX_BASE);
+  burstWrite(REG_FIFO, frame->data, frame->length);
+
+  if (!_fixedLength) {
+    explicitHeaderMode();
+    writeRegister(REG_PAYLOAD_LENGTH, frame->length);
+  }
+  writeRegister(REG_DIO_MAPPING_1, 0x40 | _dio1Mapping); // DIO0 => TXDONE
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_TX);
+
+  _txQueue.discard();
+  _txQueueActive = true;
+}
+
+void LoRaClass::enableLbt(const LoRaLbtConfig &config) 
+{
+  _lbtConfig = config;
+
+  if (_lbtConfig.maxAttempts < 1) {
+    _lbtConfig.maxAttempts = 1;
+  } else if (_lbtConfig.maxAttempts > LORA_LBT_MAX_ATTEMPTS) {
+    _lbtConfig.maxAttempts = LORA_LBT_MAX_ATTEMPTS;
+  }
+  if (_lbtConfig.maxExponent > 15) {
+    _lbtConfig.maxExponent = 15;
+  }
+  if (_lbtConfig.minExponent > _lbtConfig.maxExponent) {
+    _lbtConfig.minExponent = _lbtConfig.maxExponent;
+  }
+
+  // wideband RSSI noise, so that nodes powered up together do not back off in step
+  for (int i = 0; i < 4; i++) {
+    _lbtSeed = (_lbtSeed << 8) | random();
+  }
+  if (!_lbtSeed) {
+    _lbtSeed = 1;
+  }
+
+  memset(&_lbtStats, 0, sizeof(_lbtStats));
+  _lbtEnabled = true;
+}
+
+void LoRaClass::disableLbt() 
+{
+  _lbtEnabled = false;
+}
+
+void LoRaClass::lbtCad() 
+{
+  _lbtState = LBT_CAD;
+  _lbtAttempt++;
+  _lbtStats.cads++;
+
+  idle();
+  writeRegister(REG_DIO_MAPPING_1, 0x80 | _dio1Mapping); // DIO0 => CADDONE
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_CAD);
+}
+
+void LoRaClass::lbtCadDone(bool detected) 
+{
+  if (detected) {
+    _lbtStats.busy++;
+  } else if (_lbtConfig.rssiThreshold) {
+    // CAD only sees LoRa preambles, listen a moment for anything else
+    _lbtState = LBT_RSSI;
+    writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_RX_CONTINUOUS);
+    add_alarm_in_us(LBT_RSSI_SETTLE_US, &LoRaClass::onLbtAlarm, this, true);
+    return;
+  }
+
+  lbtResult(detected);
+}
+
+void LoRaClass::lbtResult(bool busy) 
+{
+  if (!busy) {
+    _lbtStats.sentAfter[_lbtAttempt - 1]++;
+    _lbtState = LBT_IDLE;
+    _lbtAttempt = 0;
+    _lbtClear = true;
+    _txQueueActive = false;
+    serviceTxQueue();
+    return;
+  }
+
+  if (_lbtAttempt >= _lbtConfig.maxAttempts) {
+    // give up on this frame, the next one starts with a fresh window
+    _lbtStats.dropped++;
+    _lbtState = LBT_IDLE;
+    _lbtAttempt = 0;
+    _txQueue.discard();
+    _txQueueActive = false;
+    serviceTxQueue();
+
+    if (!_txQueueActive && _txQueue.empty()) {
+      // nothing went out after all; onTxDone still marks the drained queue
+      if (_onTxDone) {
+        _onTxDone();
+      }
+    }
+    return;
+  }
+
+  // binary exponential backoff: 1 to 2^exponent slots
+  uint8_t exponent = _lbtConfig.minExponent + _lbtAttempt - 1;
+
+  if (exponent > _lbtConfig.maxExponent) {
+    exponent = _lbtConfig.maxExponent;
+  }
+
+  uint32_t slot = _lbtConfig.slotUs ? _lbtConfig.slotUs : 2 * symbolTime();
+  uint32_t delay = (1 + lbtRandom() % (1u << exponent)) * slot;
+
+  _lbtStats.backoffUs += delay;
+  _lbtState = LBT_BACKOFF;
+
+  if (_txResumeRx) {
+    // keep receiving while backing off
+    receive();
+  } else {
+    idle();
+  }
+
+  add_alarm_in_us(delay, &LoRaClass::onLbtAlarm, this, true);
+}
+
+void LoRaClass::lbtStep() 
+{
+  if (_lbtState == LBT_RSSI) {
+    bool busy = rssi() > _lbtConfig.rssiThreshold;
+
+    if (busy) {
+      _lbtStats.rssiBusy++;
+    }
+
+    idle();
+    lbtResult(busy);
+  } else if (_lbtState == LBT_BACKOFF) {
+    lbtCad();
+  }
+}
+
+uint32_t LoRaClass::lbtRandom() 
+{
+  // xorshift32
+  _lbtSeed ^= _lbtSeed << 13;
+  _lbtSeed ^= _lbtSeed >> 17;
+  _lbtSeed ^= _lbtSeed << 5;
+
+  return _lbtSeed;
+}
+
+int64_t LoRaClass::onLbtAlarm(alarm_id_t id, void *userData) 
+{
+  LoRaClass *instance = (LoRaClass *)userData;
+
+  if (instance->_deferredIrq) {
+    // the SPI bus belongs to poll() in deferred mode
+    instance->_lbtDue = true;
+  } else {
+    // same priority as the DIO0 interrupt, the two never nest
+    instance->lbtStep();
+  }
+
+  (void)id;
+  return 0;
+}
+
+bool LoRaClass::isTransmitting() 
+{
+  if ((readRegister(REG_OP_MODE) & MODE_TX) == MODE_TX) {
+    return true;
+  }
+
+  if (readRegister(REG_IRQ_FLAGS) & IRQ_TX_DONE_MASK) {
+    // clear IRQ's
+    writeRegister(REG_IRQ_FLAGS, IRQ_TX_DONE_MASK);
+  }
+
+  return false;
+}
+
+int LoRaClass::parsePacket(int size) 
+{
+  int packetLength = 0;
+
+  int irqFlags = readRegister(REG_IRQ_FLAGS);
+
+  if (_fixedLength) {
+    // header mode and length stay as setFixedFrame() left them
+  } else if (size > 0) {
+    implicitHeaderMode();
+    writeRegister(REG_PAYLOAD_LENGTH, size & 0xff);
+  } else {
+    explicitHeaderMode();
+  }
+
+  // clear IRQ's
+  writeRegister(REG_IRQ_FLAGS, irqFlags);
+  writeRegister(REG_IRQ_FLAGS, irqFlags);
+
+  if ((irqFlags & IRQ_RX_DONE_MASK) && (irqFlags & IRQ_PAYLOAD_CRC_ERROR_MASK) == 0) {
+    // received a packet
+    _packetIndex = 0;
+
+    // read packet length and metadata
+    int rxAddress = capturePacketInfo(time_us_64());
+    packetLength = _packetInfo.length;
+    _packetLength = packetLength;
+
+    // set FIFO address to current RX address
+    writeRegister(REG_FIFO_ADDR_PTR, rxAddress);
+
+    // put in standby mode
+    idle();
+  } else if (readRegister(REG_OP_MODE) != (MODE_LONG_RANGE_MODE | MODE_RX_SINGLE)) {
+    // not currently in RX mode
+
+    // reset FIFO address
+    writeRegister(REG_FIFO_ADDR_PTR, 0);
+
+    // put in single RX mode
+    writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_RX_SINGLE);
+  }
+
+  return packetLength;
+}
+
+int LoRaClass::capturePacketInfo(uint64_t timestamp) 
+{
+  // 0x10 (RX current address) to 0x2a (frequency error LSB) in one burst
+  uint8_t regs[REG_FREQ_ERROR_LSB - REG_FIFO_RX_CURRENT_ADDR + 1];
+  burstRead(REG_FIFO_RX_CURRENT_ADDR, regs, sizeof(regs));
+
+#define PKT_REG(address) regs[(address) - REG_FIFO_RX_CURRENT_ADDR]
+
+  PacketInfo &info = _packetInfo;
+
+  info.length = _implicitHeaderMode ? PKT_REG(REG_PAYLOAD_LENGTH) : PKT_REG(REG_RX_NB_BYTES);
+  info.snr = ((int8_t)PKT_REG(REG_PKT_SNR_VALUE)) * 0.25;
+  info.rssi = PKT_REG(REG_PKT_RSSI_VALUE) - (_frequency < RF_MID_BAND_THRESHOLD ? RSSI_OFFSET_LF_PORT : RSSI_OFFSET_HF_PORT);
+
+  if (info.snr < 0) {
+    // below the noise floor the packet RSSI only sees the noise (5.5.5)
+    info.rssi += (int)info.snr;
+  }
+
+  // 20-bit two's complement, sign in bit 19
+  int32_t freqError = ((int32_t)(PKT_REG(REG_FREQ_ERROR_MSB) & 0x0f) << 16) |
+                      ((int32_t)PKT_REG(REG_FREQ_ERROR_MID) << 8) |
+                      PKT_REG(REG_FREQ_ERROR_LSB);
+
+  if (freqError & 0x80000) {
+    freqError -= 0x100000;
+  }
+
+  // FXOSC is 32 MHz (2.5. Chip Specification, p. 14), p. 37
+  info.frequencyError = (long)(((float)freqError * (1L << 24) / 32E6f) * (getSignalBandwidth() / 500000.0f));
+
+  info.codingRate = (PKT_REG(REG_MODEM_STAT) >> 5) + 4;
+  info.crcOn = (PKT_REG(REG_HOP_CHANNEL) & 0x40) != 0;
+  info.timestamp = timestamp;
+
+  uint8_t rxAddress = PKT_REG(REG_FIFO_RX_CURRENT_ADDR);
+
+#undef PKT_REG
+
+  return rxAddress;
+}
+
+int LoRaClass::rssi() 
+{
+  return (readRegister(REG_RSSI_VALUE) - (_frequency < RF_MID_BAND_THRESHOLD ? RSSI_OFFSET_LF_PORT : RSSI_OFFSET_HF_PORT));
+}
+
+size_t LoRaClass::write(uint8_t byte) 
+{ 
+  return write(&byte, sizeof(byte)); 
+}
+
+size_t LoRaClass::write(const uint8_t *buffer, size_t size) 
+{
+  // check size
+  if ((_payloadLength + size) > MAX_PKT_LENGTH) {
+    size = MAX_PKT_LENGTH - _payloadLength;
+  }
+
+  // write data in a single FIFO burst
+  burstWrite(REG_FIFO, buffer, size);
+
+  // update length
+  _payloadLength += size;
+
+  return size;
+}
+
+int LoRaClass::available() 
+{
+  // packet length is latched at RxDone, no need to ask the radio again
+  return (_packetLength - _packetIndex);
+}
+
+int LoRaClass::read() 
+{
+  waitTransfer();
+
+  if (!available()) {
+    return -1;
+  }
+
+  _packetIndex++;
+
+  return readRegister(REG_FIFO);
+}
+
+int LoRaClass::peek() 
+{
+  waitTransfer();
+
+  if (!available()) {
+    return -1;
+  }
+
+  // store current FIFO address
+  int currentAddress = readRegister(REG_FIFO_ADDR_PTR);
+
+  // read
+  uint8_t b = readRegister(REG_FIFO);
+
+  // restore FIFO address
+  writeRegister(REG_FIFO_ADDR_PTR, currentAddress);
+
+  return b;
+}
+
+size_t LoRaClass::readBytes(uint8_t *buffer, size_t length) 
+{
+  waitTransfer();
+
+  int remaining = available();
+
+  if (remaining <= 0) {
+    return 0;
+  }
+
+  if (length > (size_t)remaining) {
+    length = remaining;
+  }
+
+  // FIFO address pointer advances on every read, drain it in one burst
+  burstRead(REG_FIFO, buffer, length);
+
+  _packetIndex += length;
+
+  return length;
+}
+
+int LoRaClass::readPacket(uint8_t *buffer, size_t size) 
+{
+  size_t length = readBytes(buffer, size);
+
+  // drop whatever did not fit so the next packet starts clean
+  _packetIndex = _packetLength;
+
+  return length;
+}
+
+void LoRaClass::flush() 
+{
+}
+
+void LoRaClass::setDeferredIrq(bool deferred) 
+{
+  _deferredIrq = deferred;
+}
+
+int LoRaClass::poll() 
+{
+  LoRaIrqEvent event;
+  int handled = 0;
+
+  while (_irqEvents.pop(event)) {
+    _irqTime = event.timestamp;
+    if (_fhssChannels) {
+      fhssRewind();
+    }
+    handleDio0Rise();
+    handled++;
+  }
+
+  if (_irqOverflow) {
+    // edges were lost, whatever they flagged is still in REG_IRQ_FLAGS
+    _irqOverflow = false;
+    _irqTime = time_us_64();
+    if (_fhssChannels) {
+      fhssRewind();
+    }
+    handleDio0Rise();
+    handled++;
+  }
+
+  if (_txBlockedUntil && time_us_64() >= _txBlockedUntil) {
+    kickTxQueue();
+  }
+
+  if (_rxTimeoutDeadline && time_us_64() >= _rxTimeoutDeadline) {
+    checkRxTimeout();
+  }
+
+  if (_streamingRx) {
+    streamRx();
+  }
+
+  if (_lbtDue) {
+    _lbtDue = false;
+    lbtStep();
+  }
+
+  return handled;
+}
 
-  return 1;
+uint64_t LoRaClass::irqTime() 
+{
+  return _irqTime;
 }
 
-int LoRaClass::endPacket(bool async) 
+void LoRaClass::enablePacketPool() 
 {
+  _packetPoolEnabled = true;
 
-  if ((async) && (_onTxDone))
-    writeRegister(REG_DIO_MAPPING_1, 0x40); // DIO0 => TXDONE
+  // DIO0 must interrupt even without an onReceive callback
+  _dioInstances[_dio0] = this;
+  gpio_set_irq_enabled_with_callback(_dio0, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
+}
 
-  // put in TX mode
-  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_TX);
+void LoRaClass::disablePacketPool() 
+{
+  _packetPoolEnabled = false;
+  disableStreamingRx();
 
-  if (!async) {
-    // wait for TX done
-    while ((readRegister(REG_IRQ_FLAGS) & IRQ_TX_DONE_MASK) == 0) {
-      sleep_ms(0);
-    }
-    // clear IRQ's
-    writeRegister(REG_IRQ_FLAGS, IRQ_TX_DONE_MASK);
+  if (!dio0InUse()) {
+    gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
   }
-
-  return 1;
 }
 
-bool LoRaClass::isTransmitting() 
+void LoRaClass::enableStreamingRx() 
 {
-  if ((readRegister(REG_OP_MODE) & MODE_TX) == MODE_TX) {
-    return true;
-  }
-
-  if (readRegister(REG_IRQ_FLAGS) & IRQ_TX_DONE_MASK) {
-    // clear IRQ's
-    writeRegister(REG_IRQ_FLAGS, IRQ_TX_DONE_MASK);
-  }
+  enablePacketPool();
 
-  return false;
+  _streamingRx = true;
 }
 
-int LoRaClass::parsePacket(int size) 
+void LoRaClass::disableStreamingRx() 
 {
-  int packetLength = 0;
+  gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
 
-  int irqFlags = readRegister(REG_IRQ_FLAGS);
+  _streamingRx = false;
+  _streamActive = false;
 
-  if (size > 0) {
-    implicitHeaderMode();
-    writeRegister(REG_PAYLOAD_LENGTH, size & 0xff);
-  } else {
-    explicitHeaderMode();
+  if (_streamSlab) {
+    _packetPool.discard(_streamSlab);
+    _streamSlab = NULL;
   }
 
-  // clear IRQ's
-  writeRegister(REG_IRQ_FLAGS, irqFlags);
-  writeRegister(REG_IRQ_FLAGS, irqFlags);
-
-  if ((irqFlags & IRQ_RX_DONE_MASK) && (irqFlags & IRQ_PAYLOAD_CRC_ERROR_MASK) == 0) {
-    // received a packet
-    _packetIndex = 0;
+  if (dio0InUse()) {
+    gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, true);
+  }
+}
 
-    // read packet length
-    if (_implicitHeaderMode) {
-      packetLength = readRegister(REG_PAYLOAD_LENGTH);
-    } else {
-      packetLength = readRegister(REG_RX_NB_BYTES);
-    }
+void LoRaClass::streamRx() 
+{
+  // RxDone takes the slab over; mask DIO0 so it cannot interleave with this
+  gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
 
-    // set FIFO address to current RX address
-    writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_CURRENT_ADDR));
+  if (!_streamActive) {
+    if (readRegister(REG_IRQ_FLAGS) & IRQ_VALID_HEADER_MASK) {
+      writeRegister(REG_IRQ_FLAGS, IRQ_VALID_HEADER_MASK);
 
-    // put in standby mode
-    idle();
-  } else if (readRegister(REG_OP_MODE) != (MODE_LONG_RANGE_MODE | MODE_RX_SINGLE)) {
-    // not currently in RX mode
+      if (!_streamSlab) {
+        _streamSlab = _packetPool.acquire();
+      }
 
-    // reset FIFO address
-    writeRegister(REG_FIFO_ADDR_PTR, 0);
+      if (_streamSlab) {
+        // REG_FIFO_RX_CURRENT_ADDR moves to the new frame at ValidHeader;
+        // REG_RX_NB_BYTES only follows at RxDone, so the length comes then
+        // and until RxDone the frame may be as long as the FIFO allows
+        _streamStart = readRegister(REG_FIFO_RX_CURRENT_ADDR);
+        _streamCopied = 0;
+        _streamDeadline = time_us_64() + timeOnAir(MAX_PKT_LENGTH) + IRQ_TIMEOUT_MARGIN_US;
+        _streamActive = true;
+      }
+    }
+  } else if (time_us_64() >= _streamDeadline) {
+    // no RxDone, the radio left RX mid-frame; keep the slab for the next one
+    _streamActive = false;
+  } else {
+    // REG_FIFO_RX_BYTE_ADDR holds the last byte written, start - 1 before the first
+    uint8_t written = readRegister(REG_FIFO_RX_BYTE_ADDR) + 1 - _streamStart;
 
-    // put in single RX mode
-    writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_RX_SINGLE);
+    if (written > _streamCopied) {
+      writeRegister(REG_FIFO_ADDR_PTR, _streamStart + _streamCopied);
+      burstRead(REG_FIFO, _streamSlab->data + _streamCopied, written - _streamCopied);
+      _streamCopied = written;
+    }
   }
 
-  return packetLength;
+  gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, true);
 }
 
-int LoRaClass::packetRssi() 
+PacketRef LoRaClass::takePacket() 
 {
-  return (readRegister(REG_PKT_RSSI_VALUE) - (_frequency < RF_MID_BAND_THRESHOLD ? RSSI_OFFSET_LF_PORT : RSSI_OFFSET_HF_PORT));
+  return _packetPool.take();
 }
 
-float LoRaClass::packetSnr() 
+int LoRaClass::enableDma() 
 {
-  return ((int8_t)readRegister(REG_PKT_SNR_VALUE)) * 0.25;
-}
+  if (_dmaTx >= 0) {
+    return 1;
+  }
 
-long LoRaClass::packetFrequencyError() 
-{
-  int32_t freqError = 0;
-  freqError = static_cast<int32_t>(readRegister(REG_FREQ_ERROR_MSB) & 0x111);
-  freqError <<= 8L;
-  freqError += static_cast<int32_t>(readRegister(REG_FREQ_ERROR_MID));
-  freqError <<= 8L;
-  freqError += static_cast<int32_t>(readRegister(REG_FREQ_ERROR_LSB));
+  int tx = dma_claim_unused_channel(false);
+  int rx = dma_claim_unused_channel(false);
+
+  if (tx < 0 || rx < 0) {
+    if (tx >= 0) {
+      dma_channel_unclaim(tx);
+    }
+    if (rx >= 0) {
+      dma_channel_unclaim(rx);
+    }
+    return 0;
+  }
+
+  _dmaTx = tx;
+  _dmaRx = rx;
+
+  // the RX channel finishes last, its completion ends the transfer
+  _dmaInstances[_dmaRx] = this;
 
-  if (readRegister(REG_FREQ_ERROR_MSB) & 0x1000) { // Sign bit is on
-    freqError -= 524288;                           // B1000'0000'0000'0000'0000
+  if (!_dmaIrqInstalled) {
+    // other libraries may use DMA_IRQ_0 too, its priority is left alone
+    irq_add_shared_handler(DMA_IRQ_0, &LoRaClass::onDmaIrq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+    _dmaIrqInstalled = true;
   }
 
-  const float fXtal = 32E6; // FXOSC: crystal oscillator (XTAL) frequency (2.5. Chip Specification, p. 14)
-  const float fError = ((static_cast<float>(freqError) * (1L << 24)) / fXtal) * (getSignalBandwidth() / 500000.0f); // p. 37
+  dma_channel_set_irq0_enabled(_dmaRx, true);
 
-  return static_cast<long>(fError);
+  return 1;
 }
 
-int LoRaClass::rssi() 
+void LoRaClass::disableDma() 
 {
-  return (readRegister(REG_RSSI_VALUE) - (_frequency < RF_MID_BAND_THRESHOLD ? RSSI_OFFSET_LF_PORT : RSSI_OFFSET_HF_PORT));
-}
+  if (_dmaTx < 0) {
+    return;
+  }
 
-size_t LoRaClass::write(uint8_t byte) 
-{ 
-  return write(&byte, sizeof(byte)); 
+  waitTransfer();
+
+  dma_channel_set_irq0_enabled(_dmaRx, false);
+  _dmaInstances[_dmaRx] = NULL;
+
+  dma_channel_unclaim(_dmaTx);
+  dma_channel_unclaim(_dmaRx);
+
+  _dmaTx = -1;
+  _dmaRx = -1;
+
+  for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+    if (_dmaInstances[channel]) {
+      return;
+    }
+  }
+
+  // last radio off DMA, hand the shared IRQ back untouched
+  irq_remove_handler(DMA_IRQ_0, &LoRaClass::onDmaIrq);
+  _dmaIrqInstalled = false;
 }
 
-size_t LoRaClass::write(const uint8_t *buffer, size_t size) 
+size_t LoRaClass::writeAsync(const uint8_t *buffer, size_t size) 
 {
-  int currentLength = readRegister(REG_PAYLOAD_LENGTH);
+  if (_dmaTx < 0) {
+    return write(buffer, size);
+  }
 
   // check size
-  if ((currentLength + size) > MAX_PKT_LENGTH) {
-    size = MAX_PKT_LENGTH - currentLength;
+  if ((_payloadLength + size) > MAX_PKT_LENGTH) {
+    size = MAX_PKT_LENGTH - _payloadLength;
   }
 
-  // write data
-  for (size_t i = 0; i < size; i++) {
-    writeRegister(REG_FIFO, buffer[i]);
+  if (size == 0) {
+    return 0;
   }
 
-  // update length
-  writeRegister(REG_PAYLOAD_LENGTH, currentLength + size);
+  _payloadLength += size;
+
+  startDmaTransfer(REG_FIFO | 0x80, buffer, NULL, size);
 
   return size;
 }
 
-int LoRaClass::available() 
+size_t LoRaClass::readBytesAsync(uint8_t *buffer, size_t length) 
 {
-  return (readRegister(REG_RX_NB_BYTES) - _packetIndex);
-}
+  if (_dmaTx < 0) {
+    return readBytes(buffer, length);
+  }
 
-int LoRaClass::read() 
-{
-  if (!available()) {
-    return -1;
+  // a read still in flight has not advanced _packetIndex yet
+  waitTransfer();
+
+  int remaining = available();
+
+  if (remaining <= 0) {
+    return 0;
   }
 
-  _packetIndex++;
+  if (length > (size_t)remaining) {
+    length = remaining;
+  }
 
-  return readRegister(REG_FIFO);
+  // the bytes count as read once they are in the buffer, handleDmaDone()
+  // advances _packetIndex
+  _dmaReadLength = length;
+
+  startDmaTransfer(REG_FIFO & 0x7f, NULL, buffer, length);
+
+  return length;
 }
 
-int LoRaClass::peek() 
+bool LoRaClass::transferActive() 
 {
-  if (!available()) {
-    return -1;
-  }
-
-  // store current FIFO address
-  int currentAddress = readRegister(REG_FIFO_ADDR_PTR);
+  return _dmaActive;
+}
 
-  // read
-  uint8_t b = readRegister(REG_FIFO);
+void LoRaClass::waitTransfer() 
+{
+  while (_dmaActive) {
+    // DMA_IRQ_0 cannot preempt an ISR of the same priority waiting here,
+    // so finish the transfer as soon as the RX channel reports it done
+    if (dma_channel_get_irq0_status(_dmaRx)) {
+      uint32_t status = save_and_disable_interrupts();
+
+      // the IRQ handler may have got there first
+      if (_dmaActive && dma_channel_get_irq0_status(_dmaRx)) {
+        dma_channel_acknowledge_irq0(_dmaRx);
+        handleDmaDone();
+      }
 
-  // restore FIFO address
-  writeRegister(REG_FIFO_ADDR_PTR, currentAddress);
+      restore_interrupts(status);
+    } else {
+      tight_loop_contents();
+    }
+  }
+}
 
-  return b;
+void LoRaClass::onTransferDone(void (*callback)()) 
+{
+  _onTransferDone = callback;
 }
 
-void LoRaClass::flush() 
+bool LoRaClass::dio0InUse() 
 {
+  // the DIO0 interrupt is shared by the callbacks, the pool, the TX queue,
+  // the scanner and FHSS, which rewinds to the first channel on it
+  return _onReceive || _onCadDone || _onTxDone || _packetPoolEnabled || _txQueueActive || _fhssChannels ||
+         _scanChannels;
 }
 
 void LoRaClass::onReceive(void(*callback)(int)) 
@@ -363,8 +1547,9 @@ void LoRaClass::onReceive(void(*callback)(int))
   _onReceive = callback;
 
   if (callback) {
+    _dioInstances[_dio0] = this;
     gpio_set_irq_enabled_with_callback(_dio0, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
-  } else {
+  } else if (!dio0InUse()) {
     gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
   }
 }
@@ -374,9 +1559,10 @@ void LoRaClass::onCadDone(void(*callback)(bool))
   _onCadDone = callback;
 
   if (callback) {
+    _dioInstances[_dio0] = this;
     gpio_set_irq_enabled_with_callback(_dio0, GPIO_IRQ_EDGE_RISE, true,
                                        &LoRaClass::onDio0Rise);
-  } else {
+  } else if (!dio0InUse()) {
     gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
   }
 }
@@ -386,18 +1572,26 @@ void LoRaClass::onTxDone(void (*callback)())
   _onTxDone = callback;
 
   if (callback) {
+    _dioInstances[_dio0] = this;
     gpio_set_irq_enabled_with_callback(_dio0, GPIO_IRQ_EDGE_RISE, true, &LoRaClass::onDio0Rise);
-  } else {
+  } else if (!dio0InUse()) {
     gpio_set_irq_enabled(_dio0, GPIO_IRQ_EDGE_RISE, false);
   }
 }
 
+void LoRaClass::onRxTimeout(void (*callback)()) 
+{
+  _onRxTimeout = callback;
+}
+
 void LoRaClass::receive(int size) 
 {
 
-  writeRegister(REG_DIO_MAPPING_1, 0x00); // DIO0 => RXDONE
+  writeRegister(REG_DIO_MAPPING_1, 0x00 | _dio1Mapping); // DIO0 => RXDONE
 
-  if (size > 0) {
+  if (_fixedLength) {
+    // header mode and length stay as setFixedFrame() left them
+  } else if (size > 0) {
     implicitHeaderMode();
 
     writeRegister(REG_PAYLOAD_LENGTH, size & 0xff);
@@ -408,9 +1602,35 @@ void LoRaClass::receive(int size)
   writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_RX_CONTINUOUS);
 }
 
+void LoRaClass::receiveWindow(int symbols, int size) 
+{
+  if (symbols < 4) {
+    symbols = 4;
+  } else if (symbols > 1023) {
+    symbols = 1023;
+  }
+
+  writeRegister(REG_DIO_MAPPING_1, 0x00 | _dio1Mapping); // DIO0 => RXDONE, DIO1 => RXTIMEOUT
+
+  if (_fixedLength) {
+    // header mode and length stay as setFixedFrame() left them
+  } else if (size > 0) {
+    implicitHeaderMode();
+
+    writeRegister(REG_PAYLOAD_LENGTH, size & 0xff);
+  } else {
+    explicitHeaderMode();
+  }
+
+  setSymbolTimeout(symbols);
+  armRxTimeout(symbols);
+
+  writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_RX_SINGLE);
+}
+
 void LoRaClass::channelActivityDetection(void) 
 {
-  writeRegister(REG_DIO_MAPPING_1, 0x80); // DIO0 => CADDONE
+  writeRegister(REG_DIO_MAPPING_1, 0x80 | _dio1Mapping); // DIO0 => CADDONE
   writeRegister(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_CAD);
 }
 
@@ -465,16 +1685,15 @@ void LoRaClass::setFrequency(long frequency)
 {
   _frequency = frequency;
 
-  uint64_t frf = ((uint64_t)frequency << 19) / 32000000;
+  uint8_t frf[3];
+  frequencyToFrf(frequency, frf);
 
-  writeRegister(REG_FRF_MSB, (uint8_t)(frf >> 16));
-  writeRegister(REG_FRF_MID, (uint8_t)(frf >> 8));
-  writeRegister(REG_FRF_LSB, (uint8_t)(frf >> 0));
+  burstWrite(REG_FRF_MSB, frf, sizeof(frf));
 }
 
 int LoRaClass::getSpreadingFactor() 
 {
-  return readRegister(REG_MODEM_CONFIG_2) >> 4;
+  return _modemConfig2 >> 4;
 }
 
 void LoRaClass::setSpreadingFactor(int sf) 
@@ -493,13 +1712,13 @@ void LoRaClass::setSpreadingFactor(int sf)
     writeRegister(REG_DETECTION_THRESHOLD, 0x0a);
   }
 
-  writeRegister(REG_MODEM_CONFIG_2, (readRegister(REG_MODEM_CONFIG_2) & 0x0f) | ((sf << 4) & 0xf0));
+  updateRegister(REG_MODEM_CONFIG_2, _modemConfig2, (_modemConfig2 & 0x0f) | ((sf << 4) & 0xf0));
   setLdoFlag();
 }
 
 long LoRaClass::getSignalBandwidth() 
 {
-  uint8_t bw = (readRegister(REG_MODEM_CONFIG_1) >> 4);
+  uint8_t bw = (_modemConfig1 >> 4);
 
   switch (bw) {
   case 0: return 7.8E3;
@@ -543,21 +1762,19 @@ void LoRaClass::setSignalBandwidth(long sbw)
     bw = 9;
   }
 
-  writeRegister(REG_MODEM_CONFIG_1, (readRegister(REG_MODEM_CONFIG_1) & 0x0f) | (bw << 4));
+  updateRegister(REG_MODEM_CONFIG_1, _modemConfig1, (_modemConfig1 & 0x0f) | (bw << 4));
   setLdoFlag();
 }
 
 void LoRaClass::setLdoFlag() 
 {
-  long symbolDuration = 1000 / ( getSignalBandwidth() / (1L << getSpreadingFactor()) ) ;
+  bool ldoOn = loraLowDataRateOptimize(getSpreadingFactor(), getSignalBandwidth());
 
-  bool ldoOn = symbolDuration > 16;
-
-  uint8_t config3 = readRegister(REG_MODEM_CONFIG_3);
+  uint8_t config3 = _modemConfig3;
 
   config3 = ldoOn ? config3 | (1 << 3) : config3 & ~(1 << 3);
 
-  writeRegister(REG_MODEM_CONFIG_3, config3);
+  updateRegister(REG_MODEM_CONFIG_3, _modemConfig3, config3);
 }
 
 void LoRaClass::setCodingRate4(int denominator) 
@@ -570,13 +1787,16 @@ void LoRaClass::setCodingRate4(int denominator)
 
   int cr = denominator - 4;
 
-  writeRegister(REG_MODEM_CONFIG_1, (readRegister(REG_MODEM_CONFIG_1) & 0xf1) | (cr << 1));
+  updateRegister(REG_MODEM_CONFIG_1, _modemConfig1, (_modemConfig1 & 0xf1) | (cr << 1));
 }
 
 void LoRaClass::setPreambleLength(long length) 
 {
-  writeRegister(REG_PREAMBLE_MSB, (uint8_t)(length >> 8));
-  writeRegister(REG_PREAMBLE_LSB, (uint8_t)(length >> 0));
+  uint8_t preamble[2] = { (uint8_t)(length >> 8), (uint8_t)(length >> 0) };
+
+  // REG_PREAMBLE_MSB and REG_PREAMBLE_LSB are adjacent
+  burstWrite(REG_PREAMBLE_MSB, preamble, sizeof(preamble));
+  _preambleLength = length & 0xffff;
 }
 
 void LoRaClass::setSyncWord(int sw) 
@@ -586,12 +1806,12 @@ void LoRaClass::setSyncWord(int sw)
 
 void LoRaClass::enableCrc() 
 {
-  writeRegister(REG_MODEM_CONFIG_2, readRegister(REG_MODEM_CONFIG_2) | 0x04);
+  updateRegister(REG_MODEM_CONFIG_2, _modemConfig2, _modemConfig2 | 0x04);
 }
 
 void LoRaClass::disableCrc() 
 {
-  writeRegister(REG_MODEM_CONFIG_2, readRegister(REG_MODEM_CONFIG_2) & 0xfb);
+  updateRegister(REG_MODEM_CONFIG_2, _modemConfig2, _modemConfig2 & 0xfb);
 }
 
 void LoRaClass::enableInvertIQ() 
@@ -632,16 +1852,13 @@ void LoRaClass::setGain(uint8_t gain)
   // set gain
   if (gain == 0) {
     // if gain = 0, enable AGC
-    writeRegister(REG_MODEM_CONFIG_3, 0x04);
+    updateRegister(REG_MODEM_CONFIG_3, _modemConfig3, _modemConfig3 | 0x04);
   } else {
     // disable AGC
-    writeRegister(REG_MODEM_CONFIG_3, 0x00);
+    updateRegister(REG_MODEM_CONFIG_3, _modemConfig3, _modemConfig3 & 0xfb);
 
-    // clear Gain and set LNA boost
-    writeRegister(REG_LNA, 0x03);
-
-    // set gain
-    writeRegister(REG_LNA, readRegister(REG_LNA) | (gain << 5));
+    // clear Gain, set LNA boost and gain
+    updateRegister(REG_LNA, _lna, 0x03 | (gain << 5));
   }
 }
 
@@ -650,11 +1867,12 @@ uint8_t LoRaClass::random()
   return readRegister(REG_RSSI_WIDEBAND); 
 }
 
-void LoRaClass::setPins(int ss, int reset, int dio0) 
+void LoRaClass::setPins(int ss, int reset, int dio0, int dio1) 
 {
   _ss = ss;
   _reset = reset;
   _dio0 = dio0;
+  _dio1 = dio1;
 }
 
 void LoRaClass::setSPI(spi_inst_t& spi) 
@@ -662,9 +1880,43 @@ void LoRaClass::setSPI(spi_inst_t& spi)
   _spi = &spi; 
 }
 
+void LoRaClass::setSPIPins(int miso, int sck, int mosi) 
+{
+  _miso = miso;
+  _sck = sck;
+  _mosi = mosi;
+}
+
 void LoRaClass::setSPIFrequency(uint32_t frequency)
 {
-  spi_set_baudrate(SPI_PORT, frequency);
+  spi_set_baudrate(_spi, frequency);
+}
+
+int LoRaClass::resync() 
+{
+  // check version, a radio that was reset or unplugged must answer again
+  if (readRegister(REG_VERSION) != 0x12) {
+    return 0;
+  }
+
+  uint8_t modemConfig[2];
+
+  // REG_MODEM_CONFIG_1 and REG_MODEM_CONFIG_2 are adjacent
+  burstRead(REG_MODEM_CONFIG_1, modemConfig, sizeof(modemConfig));
+
+  _modemConfig1 = modemConfig[0];
+  _modemConfig2 = modemConfig[1];
+  _modemConfig3 = readRegister(REG_MODEM_CONFIG_3);
+  _lna = readRegister(REG_LNA);
+
+  uint8_t preamble[2];
+
+  burstRead(REG_PREAMBLE_MSB, preamble, sizeof(preamble));
+  _preambleLength = (preamble[0] << 8) | preamble[1];
+
+  _implicitHeaderMode = _modemConfig1 & 0x01;
+
+  return 1;
 }
 
 void LoRaClass::dumpRegisters() 
@@ -678,14 +1930,14 @@ void LoRaClass::explicitHeaderMode()
 {
   _implicitHeaderMode = 0;
 
-  writeRegister(REG_MODEM_CONFIG_1, readRegister(REG_MODEM_CONFIG_1) & 0xfe);
+  updateRegister(REG_MODEM_CONFIG_1, _modemConfig1, _modemConfig1 & 0xfe);
 }
 
 void LoRaClass::implicitHeaderMode() 
 {
   _implicitHeaderMode = 1;
 
-  writeRegister(REG_MODEM_CONFIG_1, readRegister(REG_MODEM_CONFIG_1) | 0x01);
+  updateRegister(REG_MODEM_CONFIG_1, _modemConfig1, _modemConfig1 | 0x01);
 }
 
 void LoRaClass::handleDio0Rise() 
@@ -696,6 +1948,32 @@ void LoRaClass::handleDio0Rise()
   writeRegister(REG_IRQ_FLAGS, irqFlags);
   writeRegister(REG_IRQ_FLAGS, irqFlags);
 
+  if ((irqFlags & IRQ_RX_TIMEOUT_MASK) != 0) {
+    // RX_SINGLE window closed without a frame
+    handleRxTimeout();
+    return;
+  }
+
+  if ((irqFlags & IRQ_RX_DONE_MASK) != 0) {
+    // window closed by a frame, nothing left for poll() to check
+    _rxTimeoutDeadline = 0;
+
+    if ((irqFlags & IRQ_PAYLOAD_CRC_ERROR_MASK) != 0) {
+      // a streamed frame that failed its CRC, its slab stays as the spare
+      _streamActive = false;
+    }
+  }
+
+  if (_scanChannels && (irqFlags & IRQ_CAD_DONE_MASK) != 0) {
+    scanCadDone((irqFlags & IRQ_CAD_DETECTED_MASK) != 0);
+    return;
+  }
+
+  if (_lbtState == LBT_CAD && (irqFlags & IRQ_CAD_DONE_MASK) != 0) {
+    lbtCadDone((irqFlags & IRQ_CAD_DETECTED_MASK) != 0);
+    return;
+  }
+
   if ((irqFlags & IRQ_CAD_DONE_MASK) != 0) {
     if (_onCadDone) {
       _onCadDone((irqFlags & IRQ_CAD_DETECTED_MASK) != 0);
@@ -706,21 +1984,72 @@ void LoRaClass::handleDio0Rise()
       // received a packet
       _packetIndex = 0;
 
-      // read packet length
-      int packetLength = _implicitHeaderMode ? readRegister(REG_PAYLOAD_LENGTH) : readRegister(REG_RX_NB_BYTES);
+      // read packet length and metadata
+      int rxAddress = capturePacketInfo(_irqTime);
+      int packetLength = _packetInfo.length;
+      _packetLength = packetLength;
 
       // set FIFO address to current RX address
-      writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_CURRENT_ADDR));
+      writeRegister(REG_FIFO_ADDR_PTR, rxAddress);
+
+      if (_packetPoolEnabled) {
+        drainPacket(packetLength, rxAddress);
+      }
 
       if (_onReceive) {
         _onReceive(packetLength);
       }
     } else if ((irqFlags & IRQ_TX_DONE_MASK) != 0) {
+      if (_txQueueActive) {
+        // start the next queued frame straight away
+        _txQueueActive = false;
+        serviceTxQueue();
+
+        // next frame on air, or held back by the duty cycle
+        if (_txQueueActive || !_txQueue.empty()) {
+          return;
+        }
+      }
+
       if (_onTxDone) {
         _onTxDone();
       }
     }
   }
+
+  if (_scanChannels && (irqFlags & IRQ_RX_DONE_MASK) != 0) {
+    if ((irqFlags & IRQ_PAYLOAD_CRC_ERROR_MASK) == 0) {
+      _scanStats[_scanIndex].received++;
+    }
+
+    // RX_SINGLE is over, back to sweeping from the next channel
+    resumeScan();
+  }
+}
+
+void LoRaClass::handleHop() 
+{
+  if (!_fhssChannels) {
+    return;
+  }
+
+  // FhssPresentChannel counts the hops of the current frame, both ends
+  // derive the same table entry from it
+  uint8_t channel = (readRegister(REG_HOP_CHANNEL) & 0x3f) % _fhssChannels;
+
+  burstWrite(REG_FRF_MSB, _fhssFrf[channel], 3);
+  writeRegister(REG_IRQ_FLAGS, IRQ_FHSS_CHANGE_MASK);
+}
+
+void LoRaClass::updateRegister(uint8_t address, uint8_t &shadow, uint8_t value) 
+{
+  // shadow mirrors the radio, skip writes that would not change anything
+  if (shadow == value) {
+    return;
+  }
+
+  shadow = value;
+  writeRegister(address, value);
 }
 
 uint8_t LoRaClass::readRegister(uint8_t address) 
@@ -733,24 +2062,185 @@ void LoRaClass::writeRegister(uint8_t address, uint8_t value)
   singleTransfer(address | 0x80, value);
 }
 
+void LoRaClass::burstWrite(uint8_t address, const uint8_t *buffer, size_t size) 
+{
+  if (size == 0) {
+    return;
+  }
+
+  address |= 0x80;
+
+  uint32_t status = beginTransaction();
+
+  // the address auto-increments except on REG_FIFO, which keeps streaming
+  spi_write_blocking(_spi, &address, 1);
+  spi_write_blocking(_spi, buffer, size);
+
+  endTransaction(status);
+}
+
+void LoRaClass::burstRead(uint8_t address, uint8_t *buffer, size_t size) 
+{
+  if (size == 0) {
+    return;
+  }
+
+  address &= 0x7f;
+
+  uint32_t status = beginTransaction();
+
+  spi_write_blocking(_spi, &address, 1);
+  spi_read_blocking(_spi, 0x00, buffer, size);
+
+  endTransaction(status);
+}
+
 uint8_t LoRaClass::singleTransfer(uint8_t address, uint8_t value) 
 {
   uint8_t response;
 
-  gpio_put(_ss, 0);
+  uint32_t status = beginTransaction();
 
-  spi_write_blocking(SPI_PORT, &address, 1);
-  spi_write_read_blocking(SPI_PORT, &value, &response, 1);
+  spi_write_blocking(_spi, &address, 1);
+  spi_write_read_blocking(_spi, &value, &response, 1);
 
-  gpio_put(_ss, 1);
+  endTransaction(status);
 
   return response;
 }
 
+uint32_t LoRaClass::beginTransaction() 
+{
+  uint bus = spi_get_index(_spi);
+
+  for (;;) {
+    // interrupts stay off for the whole frame, so neither this core's ISRs
+    // nor the other core can clock the bus until endTransaction()
+    uint32_t status = spin_lock_blocking(_busLocks[bus]);
+    LoRaClass *owner = _busDma[bus];
+
+    if (!owner) {
+      gpio_put(_ss, 0);
+      return status;
+    }
+
+    // a DMA transfer holds the bus without the lock, let it finish first
+    spin_unlock(_busLocks[bus], status);
+    owner->waitTransfer();
+  }
+}
+
+void LoRaClass::endTransaction(uint32_t status) 
+{
+  gpio_put(_ss, 1);
+
+  spin_unlock(_busLocks[spi_get_index(_spi)], status);
+}
+
+void LoRaClass::startDmaTransfer(uint8_t address, const uint8_t *txBuffer, uint8_t *rxBuffer, size_t size) 
+{
+  uint bus = spi_get_index(_spi);
+  uint32_t status = beginTransaction();
+
+  // the bus stays ours until handleDmaDone(), even with the lock released
+  _busDma[bus] = this;
+  _dmaActive = true;
+
+  // the dummy byte is clocked out on reads, so it must be zero
+  _dmaDummy = 0x00;
+
+  // address byte goes out blocking, this also drains the SPI RX FIFO
+  spi_write_blocking(_spi, &address, 1);
+
+  dma_channel_config c = dma_channel_get_default_config(_dmaTx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_dreq(&c, spi_get_dreq(_spi, true));
+  channel_config_set_read_increment(&c, txBuffer != NULL);
+  channel_config_set_write_increment(&c, false);
+  dma_channel_configure(_dmaTx, &c, &spi_get_hw(_spi)->dr, txBuffer ? txBuffer : &_dmaDummy, size, false);
+
+  c = dma_channel_get_default_config(_dmaRx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_dreq(&c, spi_get_dreq(_spi, false));
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, rxBuffer != NULL);
+  dma_channel_configure(_dmaRx, &c, rxBuffer ? rxBuffer : &_dmaDummy, &spi_get_hw(_spi)->dr, size, false);
+
+  // start both together so the RX channel never misses a byte
+  dma_start_channel_mask((1u << _dmaTx) | (1u << _dmaRx));
+
+  spin_unlock(_busLocks[bus], status);
+}
+
+void LoRaClass::handleDmaDone() 
+{
+  // every byte has been clocked back in, the transaction is over
+  gpio_put(_ss, 1);
+  _busDma[spi_get_index(_spi)] = NULL;
+
+  _packetIndex += _dmaReadLength;
+  _dmaReadLength = 0;
+  _dmaActive = false;
+
+  if (_onTransferDone) {
+    _onTransferDone();
+  }
+}
+
+void LoRaClass::onDmaIrq() 
+{
+  for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+    if (_dmaInstances[channel] && dma_channel_get_irq0_status(channel)) {
+      dma_channel_acknowledge_irq0(channel);
+      _dmaInstances[channel]->handleDmaDone();
+    }
+  }
+}
+
 void LoRaClass::onDio0Rise(uint gpio, uint32_t events) 
 {
   gpio_acknowledge_irq(gpio, events);
-  LoRa.handleDio0Rise();
+
+  // the GPIO callback is shared by every radio, find the one wired to this pin
+  LoRaClass *instance = _dioInstances[gpio];
+
+  if (!instance) {
+    return;
+  }
+
+  if (instance->_fhssChannels) {
+    if ((int)gpio == instance->_dio1) {
+      // hop deadline is a fraction of a symbol, always served right here;
+      // thread-side SPI holds the bus lock with interrupts off, so this never
+      // lands inside one of its frames, even in deferred mode
+      instance->handleHop();
+      return;
+    }
+
+    // back on the first channel before the next preamble can start; in
+    // deferred mode the ISR does no more SPI than the hops need, poll() rewinds
+    if (!instance->_deferredIrq || instance->_dio0Waiting) {
+      instance->fhssRewind();
+    }
+  }
+
+  // from here on DIO1 carries RxTimeout and goes the same way as DIO0, the
+  // IRQ flags tell them apart
+  if (instance->_dio0Waiting) {
+    // a blocking call is asleep waiting for this edge
+    instance->_dio0Edge = true;
+    __sev();
+  } else if (instance->_deferredIrq) {
+    // no SPI here, poll() reads and clears the IRQ flags in thread context
+    LoRaIrqEvent event = { time_us_64() };
+    if (!instance->_irqEvents.push(event)) {
+      instance->_irqOverflow = true;
+      instance->_irqOverflows++;
+    }
+  } else {
+    instance->_irqTime = time_us_64();
+    instance->handleDio0Rise();
+  }
 }
 
 LoRaClass LoRa;
\ No newline at end of file
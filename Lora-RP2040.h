@@ -8,8 +8,13 @@
 #include "pico/binary_info.h"
 #include "hardware/gpio.h"
 #include "hardware/spi.h"
+#include "hardware/sync.h"
 #include "string.h"
 #include "Print.h"
+#include "LoRa-Queue.h"
+#include "LoRa-Packet.h"
+#include "LoRa-TimeOnAir.h"
+#include "LoRa-DutyCycle.h"
 
 #define PIN_MISO 16
 #define PIN_CS   8
@@ -24,11 +29,65 @@
 #define LORA_DEFAULT_SS_PIN        8
 #define LORA_DEFAULT_RESET_PIN     9
 #define LORA_DEFAULT_DIO0_PIN      7
-#endif
+#define LORA_DEFAULT_DIO1_PIN      -1 // not wired on the BitDogLab
 
 #define PA_OUTPUT_RFO_PIN          0
 #define PA_OUTPUT_PA_BOOST_PIN     1
 
+#define LORA_IRQ_QUEUE_SIZE        8
+
+// FhssPresentChannel is 6 bits wide
+#define LORA_FHSS_MAX_CHANNELS     64
+
+// scanning receiver channel list size
+#define LORA_SCAN_MAX_CHANNELS     16
+
+// symbols RX_SINGLE looks for the preamble after a CAD found one
+#define LORA_CAD_SYMBOL_TIMEOUT    16
+
+// enqueue(): frames wait in RAM, each one is loaded into the TX half of the
+// FIFO (0x80-0xff) in standby right before it goes out, while the RX half
+// (0x00-0x7f) stays untouched
+#define LORA_TX_QUEUE_SIZE         4
+#define LORA_TX_FIFO_SIZE          128
+
+// listen-before-talk: most CADs a queued frame may take
+#define LORA_LBT_MAX_ATTEMPTS      16
+
+// DIO0 edge captured by the ISR in deferred mode
+struct LoRaIrqEvent {
+  uint64_t timestamp;
+};
+
+struct LoRaScanStats {
+  uint32_t cads;     // CAD runs on the channel
+  uint32_t detected; // preambles found
+  uint32_t received; // packets received after a detection
+};
+
+// channel access for queued frames, see enableLbt()
+struct LoRaLbtConfig {
+  uint8_t maxAttempts = 8;  // CADs per frame before it is dropped, up to LORA_LBT_MAX_ATTEMPTS
+  uint8_t minExponent = 1;  // contention window after the first busy CAD is 2^minExponent slots,
+  uint8_t maxExponent = 6;  // doubled after every further one up to 2^maxExponent
+  uint32_t slotUs = 0;      // backoff slot, 0 = two symbols (about one CAD)
+  int rssiThreshold = 0;    // dBm; a clear CAD must also hear less than this, 0 = CAD only
+};
+
+struct LoRaLbtStats {
+  uint32_t cads;      // CAD runs
+  uint32_t busy;      // CADs that found a preamble
+  uint32_t rssiBusy;  // clear CADs overruled by the RSSI check
+  uint32_t dropped;   // frames given up after maxAttempts
+  uint64_t backoffUs; // time spent backing off
+  uint32_t sentAfter[LORA_LBT_MAX_ATTEMPTS]; // frames sent on attempt n + 1
+};
+
+struct LoRaTxFrame {
+  uint8_t length;
+  uint8_t data[LORA_TX_FIFO_SIZE];
+};
+
 static void __empty();
 
 //class LoRaClass : public Stream {
@@ -40,12 +99,97 @@ public:
   void end();
 
   int beginPacket(int implicitHeader = false);
+  // blocking (async = false) sleeps until TxDone and returns 0 if it does not
+  // come within the time on air of the frame; also 0, without transmitting,
+  // when the frame would exceed the duty-cycle budget
   int endPacket(bool async = false);
 
+  // queued TX: returns 0 if the queue is full or the frame does not fit in
+  // the TX half of the FIFO; onTxDone fires once the queue has drained.
+  // Frames held back by the duty cycle go out from poll() once allowed.
+  int enqueue(const uint8_t *buffer, size_t size);
+  size_t txQueueDepth() { return _txQueue.size(); }
+  bool txQueueBusy() { return _txQueueActive; } // a queued frame is in LBT or on air
+
+  // the same without the copy: build the frame in the next queue slot
+  // (LORA_TX_FIFO_SIZE bytes, NULL if the queue is full), then commit it
+  uint8_t *reserveTx();
+  int commitTx(size_t size);
+
+  // listen-before-talk for queued frames: each one goes out only after a
+  // clear CAD (and RSSI, if configured); a busy channel means a random
+  // backoff on an alarm, with the window doubling up to maxExponent, and a
+  // frame still blocked after maxAttempts CADs is dropped. Runs from the
+  // DIO0 interrupt and the default alarm pool, in poll() in deferred mode,
+  // so nothing blocks. The radio belongs to the queue meanwhile, like while
+  // a frame is on air. Disabling lets the frame in progress finish.
+  void enableLbt(const LoRaLbtConfig &config = LoRaLbtConfig());
+  void disableLbt();
+  const LoRaLbtStats &lbtStats() { return _lbtStats; }
+
+  // fixed frame profile for short sensor links: implicit header with the
+  // payload length programmed once, so no header goes on air and no length
+  // is written or read per packet. Also the only way to use SF6. While set,
+  // receive(), parsePacket() and enqueue() keep the profile and every frame
+  // is exactly `length` bytes.
+  int setFixedFrame(size_t length);
+  void disableFixedFrame();
+  size_t fixedFrameLength() { return _fixedLength; }
+  // writes and sends one frame, does not check for a transmission in progress
+  int sendFixed(const uint8_t *buffer, bool async = false);
+
+  // frequency hopping: every frame starts on channels[0] and moves to the
+  // next entry every hopPeriod symbols, wrapping around; both ends need the
+  // same table and period. The hop runs in the DIO1 interrupt, so DIO1 must
+  // be wired (see setPins()), and the radio goes back to channels[0] at
+  // TxDone/RxDone. Returns 0 without DIO1 or with an empty/oversized table.
+  int enableFhss(const long *channels, size_t count, uint8_t hopPeriod);
+  void disableFhss();
+
+  // scanning receiver: one radio covers several channels by sweeping them
+  // with CAD and locking into RX_SINGLE on the first one with a preamble; the
+  // sweep resumes after RxDone. Senders need a preamble longer than a whole
+  // sweep (about two symbols plus a few SPI transfers per channel). A false
+  // detection ends in an RX timeout that poll() picks up, call it regularly.
+  // onCadDone is not called while scanning.
+  int startScan(const long *channels, size_t count);
+  void stopScan();
+  bool scanning() { return _scanChannels > 0; }
+  int scanChannel() { return _scanIndex; } // entry the radio is tuned to
+  // counters of the last startScan() list, kept after stopScan(); an empty
+  // entry for any index outside it
+  const LoRaScanStats &scanStats(size_t channel);
+
+  // wake-on-radio receive: the radio sleeps and wakes every intervalUs for a
+  // CAD, and only enters RX when it finds a preamble; the CPU waits in WFE in
+  // between. Blocks until a packet arrives and returns its length, read it
+  // with read()/readPacket() like after parsePacket(), or returns 0 once
+  // timeoutUs has passed (0 waits forever). Callbacks and the pool are not
+  // used meanwhile. The sender must call setWakePreamble() with the same
+  // interval, worst case latency is one interval plus the frame.
+  int receiveLowPower(uint32_t intervalUs, uint64_t timeoutUs = 0);
+  // preamble long enough to span one sampling interval of such a receiver
+  void setWakePreamble(uint32_t intervalUs);
+
+  // microseconds a frame of this length occupies the channel, and one symbol,
+  // with the current modem settings
+  uint32_t timeOnAir(size_t length);
+  uint32_t symbolTime();
+
+  // regional duty cycle, e.g. setDutyCycle(LORA_EU868_SUB_BANDS, LORA_EU868_SUB_BAND_COUNT);
+  // every transmission is charged its time on air on the current frequency
+  void setDutyCycle(const LoRaSubBand *subBands, size_t count, uint32_t periodSeconds = 3600);
+  void disableDutyCycle();
+  bool canSend(size_t length);
+  uint64_t nextSendTime(size_t length); // time_us_64() from which it can, UINT64_MAX if never
+  uint32_t airtimeAvailable();          // microseconds left on the current sub-band
+
   int parsePacket(int size = 0);
-  int packetRssi();
-  float packetSnr();
-  long packetFrequencyError();
+  // metadata of the last received packet, captured at RxDone, no SPI traffic
+  const PacketInfo &packetInfo() { return _packetInfo; }
+  int packetRssi() { return _packetInfo.rssi; }
+  float packetSnr() { return _packetInfo.snr; }
+  long packetFrequencyError() { return _packetInfo.frequencyError; }
 
   int rssi();
 
@@ -59,11 +203,58 @@ public:
   virtual int peek();
   virtual void flush();
 
+  size_t readBytes(uint8_t *buffer, size_t length);
+  int readPacket(uint8_t *buffer, size_t size);
+
+  // DMA transport for FIFO bursts, buffers must stay valid until the transfer is done;
+  // available() still counts the bytes of a read in flight until it completes.
+  // DMA_IRQ_0 is shared and keeps its priority; where it cannot get in, e.g.
+  // inside onReceive, the next SPI access finishes the transfer and runs
+  // onTransferDone with interrupts disabled
+  int enableDma();
+  void disableDma();
+  size_t writeAsync(const uint8_t *buffer, size_t size);
+  size_t readBytesAsync(uint8_t *buffer, size_t length);
+  bool transferActive();
+  void waitTransfer();
+  void onTransferDone(void (*callback)());
+
   void onCadDone(void (*callback)(bool));
   void onReceive(void (*callback)(int));
   void onTxDone(void (*callback)());
+  void onRxTimeout(void (*callback)());
+
+  // deferred mode: the DIO0 ISR only queues a timestamp, poll() does the SPI
+  // work and runs the callbacks in the caller's context. With FHSS the DIO1
+  // hops are still served in the ISR, between the caller's SPI frames, and
+  // poll() brings the radio back to the first channel after each frame
+  void setDeferredIrq(bool deferred);
+  int poll();
+  uint64_t irqTime(); // time_us_64() of the DIO0 edge being handled
+  uint32_t irqOverflows() { return _irqOverflows; } // edges that found the ring full
+
+  // RX packet pool: each RxDone is drained once into a slab, together with
+  // RSSI, SNR, frequency error and timestamp; onReceive is optional, and
+  // when set it can still read() the packet from the FIFO
+  void enablePacketPool();
+  void disablePacketPool();
+  PacketRef takePacket();
+  LoRaPacketPool &packetPool() { return _packetPool; }
+
+  // streaming RX for long frames: after ValidHeader, poll() copies whatever
+  // REG_FIFO_RX_BYTE_ADDR says has arrived into the slab, so RxDone only
+  // reads the tail. Explicit header only; enables the pool. Call poll() a few
+  // times per frame, the more often the shorter the tail.
+  void enableStreamingRx();
+  void disableStreamingRx();
+  uint32_t streamFallbacks() { return _streamFallbacks; } // streamed frames read whole again at RxDone
 
   void receive(int size = 0);
+  // single RX window: RX_SINGLE gives up after `symbols` (4-1023) without a
+  // preamble and the radio returns to standby by itself. RxDone goes to
+  // onReceive, the timeout to onRxTimeout, straight from DIO1 when it is
+  // wired, otherwise from poll() once the window is over.
+  void receiveWindow(int symbols, int size = 0);
   void channelActivityDetection(void);
 
   void idle();
@@ -93,10 +284,14 @@ public:
 
   uint8_t random();
 
-  void setPins(int ss = LORA_DEFAULT_SS_PIN, int reset = LORA_DEFAULT_RESET_PIN, int dio0 = LORA_DEFAULT_DIO0_PIN);
+  void setPins(int ss = LORA_DEFAULT_SS_PIN, int reset = LORA_DEFAULT_RESET_PIN, int dio0 = LORA_DEFAULT_DIO0_PIN,
+               int dio1 = LORA_DEFAULT_DIO1_PIN);
   void setSPI(spi_inst_t &spi);
+  void setSPIPins(int miso = PIN_MISO, int sck = PIN_SCK, int mosi = PIN_MOSI);
   void setSPIFrequency(uint32_t frequency);
 
+  int resync(); // reload the register shadow, e.g. after a radio reset
+
   void dumpRegisters();
 
 private:
@@ -104,6 +299,32 @@ private:
   void implicitHeaderMode();
 
   void handleDio0Rise();
+  void handleHop();
+  void fhssRewind();
+  void scanNext();
+  void resumeScan();
+  void scanCadDone(bool detected);
+  void armRxTimeout(int symbols);
+  void checkRxTimeout();
+  void handleRxTimeout();
+  void setSymbolTimeout(int symbols);
+  int capturePacketInfo(uint64_t timestamp);
+  void drainPacket(int packetLength, int rxAddress);
+  void lbtCad();
+  void lbtCadDone(bool detected);
+  void lbtResult(bool busy);
+  void lbtStep();
+  uint32_t lbtRandom();
+  void streamRx();
+  void serviceTxQueue();
+  void kickTxQueue();
+  bool dio0InUse();
+  int transmitBlocking();
+  int receiveAfterCad();
+  void armDio0Wait();
+  bool waitDio0(absolute_time_t deadline);
+  void disarmDio0Wait();
+  bool takeAirtime(size_t length);
   bool isTransmitting();
 
   int getSpreadingFactor();
@@ -113,9 +334,19 @@ private:
 
   uint8_t readRegister(uint8_t address);
   void writeRegister(uint8_t address, uint8_t value);
+  void updateRegister(uint8_t address, uint8_t &shadow, uint8_t value);
+  void burstWrite(uint8_t address, const uint8_t *buffer, size_t size);
+  void burstRead(uint8_t address, uint8_t *buffer, size_t size);
   uint8_t singleTransfer(uint8_t address, uint8_t value);
+  uint32_t beginTransaction();
+  void endTransaction(uint32_t status);
+
+  void startDmaTransfer(uint8_t address, const uint8_t *txBuffer, uint8_t *rxBuffer, size_t size);
+  void handleDmaDone();
 
   static void onDio0Rise(uint, uint32_t);
+  static void onDmaIrq();
+  static int64_t onLbtAlarm(alarm_id_t id, void *userData);
 
 private:
   // SPISettings _spiSettings;
@@ -123,12 +354,80 @@ private:
   int _ss;
   int _reset;
   int _dio0;
+  int _dio1;
+  int _miso;
+  int _sck;
+  int _mosi;
   long _frequency;
   int _packetIndex;
+  int _packetLength;
+  int _payloadLength;
   int _implicitHeaderMode;
+  size_t _fixedLength;
+  // shadow copies of the configuration registers, see resync()
+  uint8_t _modemConfig1;
+  uint8_t _modemConfig2;
+  uint8_t _modemConfig3;
+  uint8_t _lna;
+  long _preambleLength;
+  PacketInfo _packetInfo;
   void (*_onReceive)(int);
   void (*_onCadDone)(bool);
   void (*_onTxDone)();
+  void (*_onRxTimeout)();
+  uint64_t _rxTimeoutDeadline; // RX_SINGLE window end, when poll() has to check for RxTimeout
+  bool _deferredIrq;
+  uint64_t _irqTime;
+  SpscQueue<LoRaIrqEvent, LORA_IRQ_QUEUE_SIZE> _irqEvents;
+  volatile bool _irqOverflow;  // an edge found the ring full, poll() rereads the IRQ flags
+  uint32_t _irqOverflows;
+  bool _packetPoolEnabled;
+  bool _streamingRx;
+  bool _streamActive;          // header seen, payload being copied into _streamSlab
+  LoRaPacketSlab *_streamSlab; // kept as a spare when a stream is abandoned
+  uint8_t _streamStart;
+  size_t _streamCopied;
+  uint64_t _streamDeadline;
+  uint32_t _streamFallbacks;
+  SpscQueue<LoRaTxFrame, LORA_TX_QUEUE_SIZE> _txQueue;
+  volatile bool _txQueueActive;
+  bool _txResumeRx;
+  uint64_t _txBlockedUntil;
+  bool _lbtEnabled;
+  LoRaLbtConfig _lbtConfig;
+  LoRaLbtStats _lbtStats;
+  uint8_t _lbtState;
+  uint8_t _lbtAttempt;      // CADs taken by the frame at the head of the queue
+  bool _lbtClear;           // that frame may go out now
+  volatile bool _lbtDue;    // deferred mode: the backoff alarm fired, poll() goes on
+  uint32_t _lbtSeed;
+  LoRaDutyCycle _dutyCycle;
+  volatile bool _dio0Waiting;
+  volatile bool _dio0Edge;
+  LoRaPacketPool _packetPool;
+  uint8_t _dio1Mapping; // DIO1-3 bits of REG_DIO_MAPPING_1, kept on every DIO0 remap
+  size_t _fhssChannels;
+  uint8_t _fhssFrf[LORA_FHSS_MAX_CHANNELS][3];
+  size_t _scanChannels;
+  size_t _scanStatsCount; // entries of _scanStats the last scan filled
+  int _scanIndex;
+  uint8_t _scanFrf[LORA_SCAN_MAX_CHANNELS][3];
+  LoRaScanStats _scanStats[LORA_SCAN_MAX_CHANNELS];
+  int _dmaTx;
+  int _dmaRx;
+  volatile bool _dmaActive;
+  size_t _dmaReadLength; // FIFO bytes of the read in flight
+  uint8_t _dmaDummy;
+  void (*_onTransferDone)();
+
+  static LoRaClass *_dioInstances[NUM_BANK0_GPIOS];
+  static LoRaClass *_dmaInstances[NUM_DMA_CHANNELS];
+  static bool _dmaIrqInstalled;
+  // radios may share a bus, one lock and one DMA owner per SPI block
+  static spin_lock_t *_busLocks[NUM_SPIS];
+  static LoRaClass *_busDma[NUM_SPIS];
 };
 
-extern LoRaClass LoRa;
\ No newline at end of file
+extern LoRaClass LoRa;
+
+#endif
@@ -22,6 +22,7 @@
 
 // Incluir biblioteca LoRa
 #include "Lora-RP2040.h"
+#include "LoRa-Compress.h"
 
 using std::string;
 
@@ -38,25 +39,32 @@ const int codingRate = 5;      // Taxa de codificação (5-8 para 4/5 até 4/8)
 const int preambleLength = 8;  // Comprimento do preâmbulo
 const int syncWord = 0x34;     // Palavra de sincronização (0x34 é o padrão)
 
-// Função para processar pacotes recebidos
-void onReceive(int packetSize) {
+// Dicionário pré-compartilhado - DEVE SER IGUAL AO DO TRANSMISSOR
+const char compressDictionary[] = "Transmissor LoRa - Mensagem #";
+
+// Descompressão dos pacotes; os que chegam sem compressão passam intactos
+LoRaCompressor compressor(LoRa);
+
+// Função para processar um pacote recebido, já copiado para o pool
+void printPacket(const PacketRef &packet) {
   // Ignorar pacotes vazios
-  if (packetSize == 0) return;
+  if (packet.length() == 0) return;
   
-  // Criar buffer para a mensagem
-  string message = "";
+  // Descomprimir o payload, se ele veio comprimido
+  char message[LORA_COMPRESS_MAX_PAYLOAD];
+  int length = compressor.decode(packet.data(), packet.length(), (uint8_t *)message, sizeof(message));
   
-  // Ler bytes do pacote
-  while (LoRa.available()) {
-    message += (char)LoRa.read();
+  if (length < 0) {
+    printf("\nPacote comprimido inválido (%u bytes)\n", (unsigned)packet.length());
+    return;
   }
   
   // Exibir informações do pacote recebido
   printf("\nPacote recebido:\n");
-  printf("Mensagem: %s\n", message.c_str());
-  printf("RSSI: %d dBm\n", LoRa.packetRssi());
-  printf("SNR: %.2f dB\n", LoRa.packetSnr());
-  printf("Erro de frequência: %ld Hz\n", LoRa.packetFrequencyError());
+  printf("Mensagem: %.*s (%u bytes no ar)\n", length, message, (unsigned)packet.length());
+  printf("RSSI: %d dBm\n", packet.rssi());
+  printf("SNR: %.2f dB\n", packet.snr());
+  printf("Erro de frequência: %ld Hz\n", packet.frequencyError());
 }
 
 int main() {
@@ -65,6 +73,10 @@ int main() {
   
   printf("\nIniciando Receptor LoRa...\n");
   
+  // Informar ao picotool os pinos usados por este exemplo
+  bi_decl(bi_3pins_with_func(PIN_MISO, PIN_MOSI, PIN_SCK, GPIO_FUNC_SPI));
+  bi_decl(bi_3pins_with_names(csPin, "LoRa CS", resetPin, "LoRa RESET", irqPin, "LoRa DIO0"));
+  
   // Configurar pinos do LoRa
   LoRa.setPins(csPin, resetPin, irqPin);
   
@@ -96,15 +108,23 @@ int main() {
   printf("- Palavra de Sincronização: 0x%02X\n", syncWord);
   printf("\nAguardando pacotes...\n");
   
-  // Configurar callback para recepção de pacotes
-  LoRa.onReceive(onReceive);
+  // Carregar o dicionário usado pela compressão
+  compressor.setDictionary((const uint8_t *)compressDictionary, strlen(compressDictionary));
+  
+  // Copiar cada pacote para o pool de recepção assim que chega, sem
+  // perder o próximo enquanto o anterior ainda está sendo impresso
+  LoRa.enablePacketPool();
   
   // Colocar o rádio em modo de recepção contínua
   LoRa.receive();
   
   // Loop principal - apenas mantém o programa rodando
   while (true) {
-    // O processamento de pacotes é feito no callback onReceive
+    // Processar os pacotes acumulados; o slab volta ao pool ao fim do bloco
+    while (PacketRef packet = LoRa.takePacket()) {
+      printPacket(packet);
+    }
+    
     sleep_ms(100);  // Pequena pausa para economizar CPU
   }
   
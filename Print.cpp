@@ -286,13 +286,15 @@ size_t Print::printULLNumber(unsigned long long n64, uint8_t base)
     n16 = qq;
   }
 
+  // digits were produced in reverse, emit them in a single write
+  char str[64];
   size_t bytes = i;
-  for (; i > 0; i--)
-    write((char) (buf[i - 1] < 10 ?
+  for (uint8_t j = 0; i > 0; i--, j++)
+    str[j] = buf[i - 1] < 10 ?
     '0' + buf[i - 1] :
-    'A' + buf[i - 1] - 10));
+    'A' + buf[i - 1] - 10;
 
-  return bytes;
+  return write(str, bytes);
 }
 
 size_t Print::printFloat(double number, int digits)
@@ -1,4 +1,6 @@
 #include "rfm95w.h"
+#include "hardware/sync.h"
+#include "LoRa-TimeOnAir.h"
 
 // --- Funções Privadas de Baixo Nível ---
 
@@ -28,6 +30,32 @@ static void lora_write_reg(lora_t *lora, uint8_t reg, uint8_t val) {
     lora_deselect(lora);
 }
 
+// Tempo no ar do pacote em microssegundos, a partir da configuração atual do
+// modem; a fórmula é a mesma do driver C++ (LoRa-TimeOnAir.h)
+static uint32_t lora_time_on_air_us(lora_t *lora, int size) {
+    uint8_t config1 = lora_read_reg(lora, REG_MODEM_CONFIG_1);
+    uint8_t config2 = lora_read_reg(lora, REG_MODEM_CONFIG_2);
+    uint8_t config3 = lora_read_reg(lora, REG_MODEM_CONFIG_3);
+    long preamble = (lora_read_reg(lora, REG_PREAMBLE_MSB) << 8) | lora_read_reg(lora, REG_PREAMBLE_LSB);
+
+    static const long bandwidths[] = {
+        7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000
+    };
+    uint8_t bw_index = config1 >> 4;
+    long bw = bw_index < 10 ? bandwidths[bw_index] : 125000;
+
+    return loraTimeOnAirUs(size, config2 >> 4, bw, ((config1 >> 1) & 0x07) + 4, preamble,
+                           (config2 >> 2) & 0x01, config1 & 0x01, (config3 >> 3) & 0x01);
+}
+
+// TxDone no DIO0: a borda de subida marca a flag e acorda o núcleo do __wfe()
+static volatile bool lora_tx_done;
+
+static void lora_dio0_callback(uint gpio, uint32_t events) {
+    lora_tx_done = true;
+    __sev();
+}
+
 // --- Funções Públicas ---
 
 void lora_sleep(lora_t *lora) {
@@ -98,7 +126,7 @@ int lora_init(lora_t *lora, spi_inst_t *spi_instance, long frequency, uint cs_pi
     return 1;
 }
 
-void lora_send_packet(lora_t *lora, uint8_t *buffer, int size) {
+int lora_send_packet(lora_t *lora, uint8_t *buffer, int size) {
     lora_idle(lora);
 
     // Posiciona o ponteiro da FIFO no início da área de TX
@@ -112,16 +140,37 @@ void lora_send_packet(lora_t *lora, uint8_t *buffer, int size) {
     // Define o tamanho do payload
     lora_write_reg(lora, REG_PAYLOAD_LENGTH, size);
 
-    // Coloca em modo de transmissão e aguarda o envio
+    // Prazo: tempo no ar do pacote mais uma margem
+    uint32_t time_on_air = lora_time_on_air_us(lora, size);
+    absolute_time_t deadline = make_timeout_time_us(time_on_air + LORA_TX_TIMEOUT_MARGIN_US);
+
+    // Mapeia o DIO0 para TxDone e arma a interrupção antes de transmitir
+    lora_write_reg(lora, REG_DIO_MAPPING_1, 0x40);
+    lora_tx_done = false;
+    gpio_set_irq_enabled_with_callback(lora->dio0_pin, GPIO_IRQ_EDGE_RISE, true, lora_dio0_callback);
+
+    // Coloca em modo de transmissão e dorme em __wfe() até o TxDone ou o prazo,
+    // sem polling do pino nem do SPI; best_effort_wfe_or_timeout() arma um
+    // alarme no prazo para não dormir além dele se o TxDone nunca vier
     lora_write_reg(lora, REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_TX);
-    while ((lora_read_reg(lora, REG_IRQ_FLAGS) & IRQ_TX_DONE_MASK) == 0) {
-        // Aguarda a transmissão ser concluída
+
+    while (!lora_tx_done) {
+        if (best_effort_wfe_or_timeout(deadline)) {
+            break;
+        }
     }
 
+    gpio_set_irq_enabled(lora->dio0_pin, GPIO_IRQ_EDGE_RISE, false);
+
+    // Um nível já alto também conta
+    int done = lora_tx_done || gpio_get(lora->dio0_pin);
+
     // Limpa a flag de interrupção
     lora_write_reg(lora, REG_IRQ_FLAGS, IRQ_TX_DONE_MASK);
 
     lora_idle(lora);
+
+    return done;
 }
 
 void lora_receive_mode(lora_t *lora) {
@@ -45,6 +45,10 @@
 #define IRQ_RX_DONE_MASK         0x40
 #define IRQ_PAYLOAD_CRC_ERROR_MASK 0x20
 
+// --- TEMPORIZAÇÃO ---
+// Margem somada ao tempo no ar calculado antes de desistir de um envio
+#define LORA_TX_TIMEOUT_MARGIN_US 2000
+
 // --- Estrutura para o dispositivo LoRa ---
 typedef struct {
     spi_inst_t *spi_instance;
@@ -74,12 +78,16 @@ int lora_init(lora_t *lora, spi_inst_t *spi_instance, long frequency, uint cs_pi
 void lora_set_frequency(lora_t *lora, long frequency);
 
 /**
- * @brief Envia um pacote de dados.
+ * @brief Envia um pacote de dados e aguarda o TxDone no pino DIO0.
+ * A espera usa a interrupção de borda de subida do DIO0 (o callback de GPIO
+ * do núcleo fica registrado para ela) e dorme em __wfe() até ela ou o prazo.
  * * @param lora Ponteiro para a estrutura lora_t.
  * @param buffer Ponteiro para os dados a serem enviados.
  * @param size Tamanho dos dados em bytes.
+ * @return int 1 se o envio terminou, 0 se o TxDone não veio dentro do tempo
+ *         no ar do pacote mais LORA_TX_TIMEOUT_MARGIN_US.
  */
-void lora_send_packet(lora_t *lora, uint8_t *buffer, int size);
+int lora_send_packet(lora_t *lora, uint8_t *buffer, int size);
 
 /**
  * @brief Verifica e recebe um pacote de dados.
@@ -0,0 +1,176 @@
+/*
+  LoRa CompressBench - Taxa de compressão e custo da camada LoRaCompressor
+
+  Comprime mensagens típicas dos exemplos (texto do LoRa_TX, telemetria em
+  JSON, um log e um bloco aleatório) sem e com o dicionário pré-compartilhado,
+  confere a ida e volta e mede os ciclos por byte de encode() e decode() no
+  host. Os ciclos são do processador do host (rdtsc em x86, senão estimados
+  pelo relógio), servem para comparar variantes, não para prever o RP2040.
+  O código de saída é diferente de zero se alguma ida e volta falhar.
+*/
+
+#include "stdio.h"
+#include "string.h"
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "LoRa-Compress.h"
+
+// repetições de cada medida, para diluir o custo do relógio
+#define BENCH_ITERATIONS 2000
+
+// fragmentos que os nós repetem em todo pacote; os dois lados carregam o mesmo
+static const char dictionary[] =
+  "{\"id\":\"node-\",\"temp\":,\"hum\":,\"press\":,\"bat\":,\"rssi\":}"
+  "Olá do dispositivo 0x - Msg #"
+  "Transmissor LoRa - Mensagem #";
+
+struct Sample {
+  const char *name;
+  uint8_t data[LORA_COMPRESS_MAX_PAYLOAD];
+  size_t length;
+};
+
+static uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  // sem contador de ciclos: nanossegundos, como se o host rodasse a 1 GHz
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void addText(Sample &sample, const char *name, const char *text)
+{
+  sample.name = name;
+  sample.length = strlen(text);
+  memcpy(sample.data, text, sample.length);
+}
+
+// ciclos por byte de entrada de uma ida ou de uma volta
+static double measure(LoRaCompressor &compressor, const Sample &sample, bool inflate)
+{
+  uint8_t frame[LORA_COMPRESS_MAX_PAYLOAD];
+  uint8_t output[LORA_COMPRESS_MAX_PAYLOAD];
+  size_t length = compressor.encode(sample.data, sample.length, frame, sizeof(frame));
+  volatile size_t sink = 0;
+  uint64_t start = cycles();
+
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    if (inflate) {
+      sink += compressor.decode(frame, length, output, sizeof(output));
+    } else {
+      sink += compressor.encode(sample.data, sample.length, output, sizeof(output));
+    }
+  }
+
+  (void)sink;
+  return (double)(cycles() - start) / BENCH_ITERATIONS / sample.length;
+}
+
+// tamanho comprimido, ou 0 se a ida e volta não devolver a entrada
+static size_t roundTrip(LoRaCompressor &compressor, const Sample &sample)
+{
+  uint8_t frame[LORA_COMPRESS_MAX_PAYLOAD];
+  uint8_t output[LORA_COMPRESS_MAX_PAYLOAD];
+  size_t length = compressor.encode(sample.data, sample.length, frame, sizeof(frame));
+  int decoded = compressor.decode(frame, length, output, sizeof(output));
+
+  if (!length || decoded != (int)sample.length || memcmp(output, sample.data, sample.length) != 0) {
+    return 0;
+  }
+  return length;
+}
+
+int main()
+{
+  static Sample samples[6];
+  int failures = 0;
+
+  addText(samples[0], "LoRa_TX", "Transmissor LoRa - Mensagem #137");
+  addText(samples[1], "LoRa_Duplex", "Olá do dispositivo 0xBB - Msg #37");
+  addText(samples[2], "sensor JSON",
+          "{\"id\":\"node-07\",\"temp\":23.41,\"hum\":61.2,\"press\":1013.25,\"bat\":3.91,\"rssi\":-97}");
+  addText(samples[3], "lote JSON",
+          "[{\"id\":\"node-07\",\"temp\":23.41,\"hum\":61.2},{\"id\":\"node-07\",\"temp\":23.44,\"hum\":61.0},"
+          "{\"id\":\"node-07\",\"temp\":23.47,\"hum\":60.9},{\"id\":\"node-07\",\"temp\":23.52,\"hum\":60.7}]");
+  addText(samples[4], "log",
+          "12:00:01 rx ok rssi=-97 snr=7.25\n12:00:03 rx ok rssi=-98 snr=7.00\n"
+          "12:00:05 rx crc erro rssi=-112\n12:00:07 rx ok rssi=-96 snr=7.50\n");
+
+  // aleatório: não comprime e precisa sair em texto puro
+  uint32_t seed = 0x12345678;
+
+  samples[5].name = "aleatorio";
+  samples[5].length = 96;
+  for (size_t i = 0; i < samples[5].length; i++) {
+    seed = seed * 1664525 + 1013904223;
+    samples[5].data[i] = seed >> 24;
+  }
+  samples[5].data[0] &= 0x7f; // não começar pelo marcador
+
+  LoRaCompressor plain;
+  LoRaCompressor shared;
+
+  shared.setDictionary((const uint8_t *)dictionary, strlen(dictionary));
+
+  printf("%-12s %5s %12s %12s %10s %10s\n", "amostra", "bytes", "sem dic.", "com dic.",
+         "enc c/B", "dec c/B");
+
+  for (const Sample &sample : samples) {
+    size_t without = roundTrip(plain, sample);
+    size_t with = roundTrip(shared, sample);
+
+    if (!without || !with) {
+      printf("falha: ida e volta de %s\n", sample.name);
+      failures++;
+      continue;
+    }
+
+    printf("%-12s %5u %5u (%3.0f%%) %5u (%3.0f%%) %10.1f %10.1f\n", sample.name, (unsigned)sample.length,
+           (unsigned)without, 100.0 * without / sample.length, (unsigned)with, 100.0 * with / sample.length,
+           measure(shared, sample, false), measure(shared, sample, true));
+  }
+
+  // o bloco aleatório não pode crescer: sai puro, do mesmo tamanho
+  if (roundTrip(shared, samples[5]) != samples[5].length) {
+    printf("falha: bloco aleatório expandido\n");
+    failures++;
+  }
+
+  // a mensagem do LoRa_TX com o dicionário tem de caber em bem menos bytes
+  if (roundTrip(shared, samples[0]) * 2 > samples[0].length) {
+    printf("falha: dicionário sem efeito na mensagem do LoRa_TX\n");
+    failures++;
+  }
+
+  // quadros corrompidos (cada byte trocado, cada truncamento) nunca passam do buffer de saída
+  uint8_t frame[LORA_COMPRESS_MAX_PAYLOAD];
+  uint8_t output[LORA_COMPRESS_MAX_PAYLOAD];
+  size_t length = shared.encode(samples[3].data, samples[3].length, frame, sizeof(frame));
+  int overruns = 0;
+
+  for (size_t i = 1; i < length; i++) {
+    for (int value = 0; value < 256; value += 17) {
+      uint8_t saved = frame[i];
+
+      frame[i] = value;
+      overruns += shared.decode(frame, length, output, samples[3].length) > (int)samples[3].length;
+      frame[i] = saved;
+    }
+    overruns += shared.decode(frame, i, output, sizeof(output)) >= 0;
+  }
+  if (overruns) {
+    printf("falha: %d quadros corrompidos aceitos\n", overruns);
+    failures++;
+  }
+
+  printf("\nRAM do compressor: %u bytes\n", (unsigned)sizeof(LoRaCompressor));
+
+  return failures;
+}
@@ -0,0 +1,1572 @@
+/*
+  LoRa SimBench - Contagem de transações SPI do driver no simulador
+
+  Executa os caminhos críticos do LoRaClass contra o modelo do SX1276 no host
+  e imprime, para cada etapa, quantas transações (CS baixo) e bytes SPI foram
+  gastos e quanto tempo virtual passou. Cada recurso do driver tem a sua
+  função de teste, e uma falha termina com o nome do recurso. O código de
+  saída é diferente de zero se alguma etapa falhar ou gastar mais transações
+  que o seu orçamento, para uso em CI.
+*/
+
+#include "stdio.h"
+#include "string.h"
+
+#include "Lora-RP2040.h"
+#include "LoRa-Engine.h"
+#include "LoRa-Transfer.h"
+#include "LoRa-Link.h"
+#include "LoRa-Frame.h"
+#include "LoRa-Compress.h"
+#include "SX1276Model.h"
+#include "pico_sim.h"
+
+// Tempo no ar de referência, em us, calculado à parte com frações exatas pela fórmula da
+// seção 4.1.1.7 do datasheet do SX1276 (o mesmo que dá a calculadora da Semtech), sem
+// passar pelo código do driver nem do modelo. LDO ligado acima de 16 ms por símbolo.
+struct AirtimeCase {
+  size_t length;
+  int sf;
+  long bw;
+  int cr;
+  long preamble;
+  bool crc;
+  bool implicitHeader;
+  uint32_t us;
+};
+
+static constexpr AirtimeCase airtimeTable[] = {
+  {  10,  7, 125000, 5,  8, true,  false,   41216 }, // configuração dos exemplos
+  {  10, 12, 125000, 5,  8, true,  false,  991232 }, // SF12 com LDO
+  {  51, 11, 125000, 5,  8, true,  false, 1314816 }, // SF11 com LDO
+  {  12,  6, 125000, 5,  8, true,  true,    20608 }, // SF6, só existe com cabeçalho implícito
+  {  12,  6, 250000, 5,  8, false, true,    10304 }, // SF6 sem CRC
+  {  32, 10, 125000, 6,  8, true,  true,   460800 }, // cabeçalho implícito, CR 4/6
+  {   1, 12, 125000, 8, 12, false, true,   794624 }, // LDO, implícito, CR 4/8, sem CRC
+  {  20,  9, 125000, 8,  8, true,  false,  246784 }, // CR 4/8
+  { 200,  8, 250000, 7, 16, true,  false,  394496 }, // CR 4/7, preâmbulo 16
+  {  64,  7, 500000, 5,  8, true,  false,   29504 }, // 500 kHz
+  { 255, 12, 500000, 8,  8, true,  false, 2983936 }, // 500 kHz: 8 ms por símbolo, sem LDO
+};
+
+static constexpr bool airtimeTableMatches()
+{
+  for (const AirtimeCase &c : airtimeTable) {
+    if (loraTimeOnAirUs(c.length, c.sf, c.bw, c.cr, c.preamble, c.crc, c.implicitHeader) != c.us) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static_assert(airtimeTableMatches(), "tempo no ar em tempo de compilação");
+
+// DIO1 não existe na BitDogLab, a bancada o liga em um GPIO livre
+#define BENCH_DIO1_PIN 6
+
+// Rádio simulado ligado como nos exemplos
+static SX1276Model radio(spi0, LORA_DEFAULT_SS_PIN, LORA_DEFAULT_DIO0_PIN, BENCH_DIO1_PIN);
+
+// segundo rádio, ligado como o rádio 2 do LoRa_MultiRadio
+static SX1276Model radioB(spi1, 13, 15);
+static LoRaClass LoRaB;
+
+// terceiro rádio no mesmo spi0 do primeiro, só com CS e DIO0 próprios
+static SX1276Model radioC(spi0, 20, 22);
+static LoRaClass LoRaC;
+
+static volatile int sharedLength = 0;
+static uint8_t sharedReceived[256];
+
+static void onSharedReceive(int packetSize)
+{
+  sharedLength = LoRaC.readPacket(sharedReceived, sizeof(sharedReceived));
+  (void)packetSize;
+}
+
+// payload de teste: 0, 1, 2, ... 254
+static uint8_t payload[255];
+
+static volatile int receivedLength = 0;
+static uint8_t received[256];
+
+static void onReceive(int packetSize)
+{
+  receivedLength = LoRa.readPacket(received, sizeof(received));
+  (void)packetSize;
+}
+
+// transporte por DMA: o RxDone dispara a leitura assíncrona, o fim chega pelo callback
+static volatile int dmaTransfers = 0;
+static volatile int dmaReadLength = 0;
+static volatile int dmaRssi = 0;
+static uint8_t dmaReceived[256];
+
+static void onDmaReceive(int packetSize)
+{
+  dmaReadLength = LoRa.readBytesAsync(dmaReceived, sizeof(dmaReceived));
+
+  // mais SPI ainda dentro da ISR: o DMA_IRQ_0 não entra aqui, a leitura termina pelo canal
+  dmaRssi = LoRa.rssi();
+  (void)packetSize;
+}
+
+static void onDmaDone()
+{
+  dmaTransfers++;
+}
+
+static volatile bool queueDrained = false;
+
+static void onQueueDrained()
+{
+  queueDrained = true;
+}
+
+// a FIFO do modelo começa a transmitir pela base de TX e dá a volta em 0xff
+static bool fifoMatches(const uint8_t *buffer, size_t size, uint8_t base)
+{
+  for (size_t i = 0; i < size; i++) {
+    if (radio.fifo()[(uint8_t)(base + i)] != buffer[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// confere cada permanência do último quadro com a tabela de saltos
+static bool hopsMatch(const long *channels, size_t count)
+{
+  if (radio.hopCount() < 2) {
+    return false;
+  }
+
+  for (size_t i = 0; i < radio.hopCount(); i++) {
+    if (radio.hopFrf(i) != ((uint64_t)channels[i % count] << 19) / 32000000) {
+      return false;
+    }
+  }
+
+  return radio.frf() == ((uint64_t)channels[0] << 19) / 32000000;
+}
+
+static volatile int rxTimeouts = 0;
+
+static void onRxTimeout()
+{
+  rxTimeouts++;
+}
+
+static volatile uint64_t drainedAt = 0;
+
+static void onPacketDrained(int packetSize)
+{
+  drainedAt = time_us_64();
+  (void)packetSize;
+}
+
+// do RxDone até o payload inteiro no slab, com poll() a cada 500 us durante o quadro
+static uint64_t drainLatency(const uint8_t *buffer, size_t size)
+{
+  uint64_t start = time_us_64();
+
+  drainedAt = 0;
+  radio.injectPacket(buffer, size);
+  while (drainedAt == 0 && time_us_64() - start < 2000000) {
+    sleep_us(500);
+    LoRa.poll();
+  }
+
+  PacketRef packet = LoRa.takePacket();
+
+  if (!packet || packet.length() != size || memcmp(packet.data(), buffer, size) != 0) {
+    return UINT64_MAX;
+  }
+
+  return drainedAt - packet.timestamp();
+}
+
+// enlace confiável: mensagens numeradas do nó 0xaa para o 0xbb, que confere a ordem
+static uint16_t linkExpected = 0;
+static uint32_t linkOutOfOrder = 0;
+
+static void onLinkMessage(uint8_t from, const uint8_t *buffer, size_t size)
+{
+  uint16_t number = buffer[0] | (buffer[1] << 8);
+
+  if (from != 0xaa || number != linkExpected || size < 2) {
+    linkOutOfOrder++;
+  }
+  linkExpected = number + 1;
+}
+
+// entrega count mensagens de size bytes, devolve o tempo até a última ser confirmada
+static uint64_t linkRun(LoRaLink &a, LoRaLink &b, int count, size_t size)
+{
+  uint8_t message[LORA_LINK_PAYLOAD_SIZE];
+  uint64_t start = time_us_64();
+  int queued = 0;
+
+  memset(message, 0x5a, sizeof(message));
+  linkExpected = 0;
+  linkOutOfOrder = 0;
+
+  while ((queued < count || a.pending(0xbb)) && time_us_64() - start < 120000000) {
+    // a aplicação enche a janela sempre que ela abre
+    while (queued < count) {
+      message[0] = queued & 0xff;
+      message[1] = queued >> 8;
+      if (!a.send(0xbb, message, size)) {
+        break;
+      }
+      queued++;
+    }
+
+    a.poll();
+    b.poll();
+    sleep_ms(1);
+  }
+
+  return time_us_64() - start;
+}
+
+// espera o rádio começar a transmitir, devolve o instante ou 0
+static uint64_t waitTxStart(uint64_t timeoutUs)
+{
+  uint32_t txBefore = radio.txCount();
+  uint64_t start = time_us_64();
+
+  while (radio.txCount() == txBefore) {
+    if (time_us_64() - start > timeoutUs) {
+      return 0;
+    }
+    sleep_us(100);
+  }
+
+  return time_us_64();
+}
+
+// etapas que passam do orçamento de transações SPI falham, para barrar regressões no CI
+static int report(const char *step, uint64_t startUs, uint32_t budget)
+{
+  uint32_t transactions = radio.spiTransactions();
+
+  printf("%-28s %8lu %8lu %8lu %10llu\n", step,
+         (unsigned long)transactions,
+         (unsigned long)radio.spiBytes(),
+         (unsigned long)budget,
+         (unsigned long long)(time_us_64() - startUs));
+  radio.resetStats();
+
+  if (transactions > budget) {
+    printf("falha: %s gastou %lu transações, orçamento %lu\n", step, (unsigned long)transactions,
+           (unsigned long)budget);
+    return 1;
+  }
+
+  return 0;
+}
+
+// begin e configuração do modem usados por todas as outras etapas
+static int testBegin()
+{
+  uint64_t start;
+  int failures = 0;
+
+  start = time_us_64();
+  if (!LoRa.begin(915E6)) {
+    printf("falha: begin\n");
+    return 1;
+  }
+  LoRa.setSPIFrequency(LORA_DEFAULT_SPI_FREQUENCY);
+  failures += report("begin", start, 16);
+
+  start = time_us_64();
+  LoRa.setSpreadingFactor(7);
+  LoRa.setSignalBandwidth(125E3);
+  LoRa.setCodingRate4(5);
+  LoRa.setPreambleLength(8);
+  LoRa.setSyncWord(0x34);
+  LoRa.enableCrc();
+  failures += report("configuracao", start, 5);
+
+  return failures;
+}
+
+// transmissão síncrona: FIFO em uma rajada, endPacket() e print()
+static int testTx()
+{
+  uint64_t start;
+  int failures = 0;
+
+  start = time_us_64();
+  LoRa.beginPacket();
+  LoRa.write(payload, sizeof(payload));
+  failures += report("tx: preencher FIFO 255B", start, 5);
+
+  start = time_us_64();
+  LoRa.endPacket();
+  failures += report("tx: endPacket sincrono", start, 4);
+
+  if (radio.reg(0x22) != sizeof(payload) || !fifoMatches(payload, sizeof(payload), radio.reg(0x0e))) {
+    printf("falha: conteudo da FIFO de TX\n");
+    failures++;
+  }
+
+  start = time_us_64();
+  LoRa.beginPacket();
+  LoRa.print("Transmissor LoRa - Mensagem #");
+  LoRa.print(12345);
+  LoRa.endPacket();
+  failures += report("tx: print + endPacket", start, 10);
+
+  return failures;
+}
+
+// recepção com onReceive na ISR
+static int testRx()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.onReceive(onReceive);
+  LoRa.receive();
+  radio.resetStats();
+
+  start = time_us_64();
+  radio.injectPacket(payload, sizeof(payload));
+  while (receivedLength == 0 && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+  }
+  failures += report("rx: RxDone + readPacket", start, 6);
+
+  if (receivedLength != sizeof(payload) || memcmp(received, payload, sizeof(payload)) != 0) {
+    printf("falha: pacote recebido\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// DMA: 255 bytes para a FIFO e de volta pelo mock de DMA do simulador
+static int testDma()
+{
+  uint64_t start;
+  int failures = 0;
+
+  if (!LoRa.enableDma()) {
+    printf("falha: enableDma\n");
+    return 1;
+  }
+  LoRa.onTransferDone(onDmaDone);
+  LoRa.idle();
+  radio.resetStats();
+
+  start = time_us_64();
+  LoRa.beginPacket();
+  size_t dmaWritten = LoRa.writeAsync(payload, sizeof(payload));
+  LoRa.waitTransfer();
+  bool dmaTxOk = dmaWritten == sizeof(payload) && dmaTransfers == 1 &&
+                 fifoMatches(payload, sizeof(payload), radio.reg(0x0e));
+  LoRa.endPacket();
+  failures += report("tx: DMA 255B + endPacket", start, 9);
+
+  if (!dmaTxOk || radio.reg(0x22) != sizeof(payload)) {
+    printf("falha: escrita por DMA\n");
+    failures++;
+  }
+
+  LoRa.onReceive(onDmaReceive);
+  LoRa.receive();
+  radio.resetStats();
+
+  start = time_us_64();
+  radio.injectPacket(payload, sizeof(payload));
+  while (dmaTransfers < 2 && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+  }
+  LoRa.waitTransfer();
+  failures += report("rx: RxDone + DMA 255B", start, 7);
+
+  if (dmaReadLength != sizeof(payload) || dmaTransfers != 2 || LoRa.available() != 0 || dmaRssi == 0 ||
+      memcmp(dmaReceived, payload, sizeof(payload)) != 0) {
+    printf("falha: leitura por DMA\n");
+    failures++;
+  }
+
+  LoRa.onTransferDone(NULL);
+  LoRa.disableDma();
+  LoRa.onReceive(onReceive);
+
+  return failures;
+}
+
+// fila de TX: três quadros seguidos, o rádio volta a receber no fim
+static int testTxQueue()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.onTxDone(onQueueDrained);
+  radio.resetStats();
+
+  start = time_us_64();
+  for (int i = 0; i < 3; i++) {
+    LoRa.enqueue(payload, LORA_TX_FIFO_SIZE);
+  }
+  while (!queueDrained && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+  }
+  uint32_t queued = radio.txCount();
+  failures += report("tx: fila 3 x 128B", start, 30);
+
+  if (queued != 3 || LoRa.txQueueDepth() != 0 || radio.reg(0x01) != 0x85) {
+    printf("falha: fila de TX\n");
+    failures++;
+  }
+  LoRa.onTxDone(NULL);
+  LoRa.receive();
+
+  return failures;
+}
+
+// mesmo pacote com o DIO0 adiado: a ISR só enfileira, poll() lê a FIFO
+static int testDeferredIrq()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.setDeferredIrq(true);
+  LoRa.receive();
+  receivedLength = 0;
+  radio.resetStats();
+
+  start = time_us_64();
+  radio.injectPacket(payload, 32);
+  while (receivedLength == 0 && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+    LoRa.poll();
+  }
+  failures += report("rx: adiado + poll()", start, 6);
+
+  if (receivedLength != 32 || memcmp(received, payload, 32) != 0) {
+    printf("falha: pacote recebido com IRQ adiada\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// pool de pacotes: três quadros seguidos sem a aplicação ler nenhum
+static int testPacketPool()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.onReceive(NULL);
+  LoRa.enablePacketPool();
+  radio.resetStats();
+
+  start = time_us_64();
+  for (int i = 0; i < 3; i++) {
+    uint32_t rxBefore = radio.rxCount();
+
+    payload[0] = (uint8_t)i;
+    radio.injectPacket(payload, 64);
+    while (radio.rxCount() == rxBefore && time_us_64() - start < 2000000) {
+      sleep_ms(1);
+      LoRa.poll();
+    }
+  }
+  LoRa.poll();
+  failures += report("rx: pool 3 x 64B", start, 18);
+
+  for (int i = 0; i < 3; i++) {
+    PacketRef packet = LoRa.takePacket();
+
+    if (!packet || packet.length() != 64 || packet.data()[0] != i || packet.timestamp() == 0) {
+      printf("falha: pacote %d do pool\n", i);
+      failures++;
+    }
+  }
+  if (LoRa.takePacket() || LoRa.packetPool().freeSlabs() != LORA_PACKET_POOL_SIZE) {
+    printf("falha: slabs do pool\n");
+    failures++;
+  }
+
+  // com o pool ligado, um onReceive antigo ainda lê o pacote pela FIFO
+  LoRa.onReceive(onReceive);
+  receivedLength = 0;
+  payload[0] = 0;
+  start = time_us_64();
+  radio.injectPacket(payload, 64);
+  while (receivedLength == 0 && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+    LoRa.poll();
+  }
+
+  PacketRef copy = LoRa.takePacket();
+
+  if (receivedLength != 64 || memcmp(received, payload, 64) != 0 || !copy || copy.length() != 64 ||
+      memcmp(copy.data(), payload, 64) != 0) {
+    printf("falha: read() dentro do onReceive com o pool\n");
+    failures++;
+  }
+  copy.release();
+  LoRa.onReceive(NULL);
+
+  return failures;
+}
+
+// metadados: um quadro abaixo do ruído com erro de frequência negativo
+static int testPacketInfo()
+{
+  uint64_t start;
+  int failures = 0;
+
+  radio.setFrequencyError(-2500);
+  radio.resetStats();
+
+  start = time_us_64();
+  uint32_t rxBefore = radio.rxCount();
+  radio.injectPacket(payload, 20, -118, -5.0f);
+  while (radio.rxCount() == rxBefore && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+    LoRa.poll();
+  }
+  LoRa.poll();
+  failures += report("rx: PacketInfo", start, 6);
+
+  PacketRef packet = LoRa.takePacket();
+  long feiError = packet ? packet.frequencyError() + 2500 : 0;
+
+  if (!packet || packet.info().length != 20 || packet.rssi() != -123 || packet.snr() != -5.0f ||
+      feiError < -10 || feiError > 10 || packet.info().codingRate != 5 || !packet.info().crcOn ||
+      LoRa.packetRssi() != packet.rssi() || LoRa.packetInfo().timestamp != packet.timestamp()) {
+    printf("falha: PacketInfo (rssi %d, snr %.2f, erro %ld Hz)\n",
+           packet ? packet.rssi() : 0, packet ? packet.snr() : 0.0f, packet ? packet.frequencyError() : 0L);
+    failures++;
+  }
+  packet.release();
+  radio.setFrequencyError(0);
+
+  payload[0] = 0;
+  LoRa.disablePacketPool();
+
+  return failures;
+}
+
+// motor no core1: o core0 só enfileira e lê as filas
+static int testEngine()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.setDeferredIrq(false);
+  LoRa.onReceive(NULL);
+  LoRaEngine engine(LoRa);
+  LoRaEngineFrame frame;
+  LoRaEngineEvent event;
+  uint32_t sent;
+  int txDone = 0;
+
+  engine.start();
+  radio.resetStats();
+
+  start = time_us_64();
+  for (int i = 0; i < 3; i++) {
+    engine.send(payload, 16);
+  }
+  while (txDone < 3 && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+    while (engine.pollEvent(event)) {
+      txDone += event.type == LORA_EVENT_TX_DONE;
+    }
+  }
+  sent = radio.txCount();
+  failures += report("core1: 3 x TX 16B", start, 35);
+
+  if (sent != 3 || engine.txDepth() != 0) {
+    printf("falha: envio pelo motor do core1\n");
+    failures++;
+  }
+
+  start = time_us_64();
+  radio.injectPacket(payload, 48);
+  while (!engine.receive(frame) && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+  }
+  failures += report("core1: RX 48B", start, 6);
+
+  if (frame.length != 48 || memcmp(frame.data, payload, 48) != 0) {
+    printf("falha: recepcao pelo motor do core1\n");
+    failures++;
+  }
+
+  engine.stop();
+
+  return failures;
+}
+
+// ciclo de trabalho: 1% em 868,1 MHz, período curto para a simulação
+static int testDutyCycle()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.setFrequency(868.1E6);
+  LoRa.setDutyCycle(LORA_EU868_SUB_BANDS, LORA_EU868_SUB_BAND_COUNT, 10);
+  LoRa.onTxDone(onQueueDrained);
+  LoRa.receive();
+  queueDrained = false;
+  radio.resetStats();
+
+  uint32_t airtime = LoRa.timeOnAir(32);
+  uint64_t budget = 10 * 1000000 / 100;
+
+  start = time_us_64();
+  for (int i = 0; i < 3; i++) {
+    LoRa.enqueue(payload, 32);
+  }
+  bool limited = !LoRa.canSend(32) && LoRa.nextSendTime(32) > time_us_64();
+  while (!queueDrained && time_us_64() - start < 60000000) {
+    sleep_ms(10);
+    LoRa.poll();
+  }
+  uint64_t elapsed = time_us_64() - start;
+  uint32_t queued = radio.txCount();
+  failures += report("duty cycle: 3 x 32B a 1%", start, 34);
+
+  // o terceiro quadro só sai depois de recuperar o que passou do orçamento
+  if (!limited || queued != 3 || elapsed < (3 * airtime - budget) * 100) {
+    printf("falha: ciclo de trabalho\n");
+    failures++;
+  }
+  LoRa.disableDutyCycle();
+  LoRa.onTxDone(NULL);
+  LoRa.setFrequency(915E6);
+
+  // sub-banda fechada (0%): nunca dá para enviar; fora da tabela, sempre
+  static const LoRaSubBand closedBand[] = { { 868000000, 869000000, 0 } };
+  LoRaDutyCycle closed;
+
+  closed.begin(closedBand, 1, 10);
+  if (closed.canSend(868100000, airtime, 0) || closed.nextSendTime(868100000, airtime, 0) != UINT64_MAX ||
+      !closed.canSend(915000000, airtime, 1000) || closed.nextSendTime(915000000, airtime, 1000) != 1000) {
+    printf("falha: sub-banda com ciclo de trabalho zero\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// quadro fixo: SF6, cabeçalho implícito e 12 bytes programados uma vez
+static int testFixedFrame()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.setSpreadingFactor(6);
+  LoRa.setFixedFrame(12);
+  radio.resetStats();
+
+  start = time_us_64();
+  int fixedSent = LoRa.sendFixed(payload);
+  failures += report("tx: sendFixed 12B SF6", start, 6);
+
+  if (!fixedSent || radio.reg(0x22) != 12 || !(radio.reg(0x1d) & 0x01) ||
+      !fifoMatches(payload, 12, radio.reg(0x0e))) {
+    printf("falha: envio de quadro fixo\n");
+    failures++;
+  }
+
+  LoRa.onReceive(onReceive);
+  LoRa.receive();
+  receivedLength = 0;
+  radio.resetStats();
+
+  start = time_us_64();
+  radio.injectPacket(payload, 12);
+  while (receivedLength == 0 && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+  }
+  failures += report("rx: quadro fixo 12B SF6", start, 6);
+
+  if (receivedLength != 12 || memcmp(received, payload, 12) != 0 || radio.reg(0x22) != 12) {
+    printf("falha: recepcao de quadro fixo\n");
+    failures++;
+  }
+  LoRa.onReceive(NULL);
+  LoRa.idle();
+  LoRa.disableFixedFrame();
+
+  return failures;
+}
+
+// FHSS: oito canais de uplink US915, salto a cada 10 símbolos
+static int testFhss()
+{
+  uint64_t start;
+  int failures = 0;
+
+  static const long hopTable[] = {
+    902300000, 902500000, 902700000, 902900000, 903100000, 903300000, 903500000, 903700000
+  };
+
+  LoRa.setSpreadingFactor(7);
+  LoRa.setPins(LORA_DEFAULT_SS_PIN, LORA_DEFAULT_RESET_PIN, LORA_DEFAULT_DIO0_PIN, BENCH_DIO1_PIN);
+  if (!LoRa.enableFhss(hopTable, 8, 10)) {
+    printf("falha: enableFhss\n");
+    failures++;
+  }
+  radio.resetStats();
+
+  start = time_us_64();
+  LoRa.beginPacket();
+  LoRa.write(payload, 64);
+  LoRa.endPacket();
+  failures += report("tx: FHSS 64B", start, 37);
+
+  if (!hopsMatch(hopTable, 8)) {
+    printf("falha: saltos na transmissao (%u permanencias)\n", (unsigned)radio.hopCount());
+    failures++;
+  }
+
+  LoRa.onReceive(onReceive);
+  LoRa.receive();
+  receivedLength = 0;
+  radio.resetStats();
+
+  start = time_us_64();
+  radio.injectPacket(payload, 64);
+  while (receivedLength == 0 && time_us_64() - start < 2000000) {
+    sleep_ms(1);
+  }
+  failures += report("rx: FHSS 64B", start, 34);
+
+  if (receivedLength != 64 || memcmp(received, payload, 64) != 0 || !hopsMatch(hopTable, 8)) {
+    printf("falha: saltos na recepcao (%u permanencias)\n", (unsigned)radio.hopCount());
+    failures++;
+  }
+
+  // modo adiado: os saltos continuam na ISR do DIO1 enquanto a thread faz rajadas no SPI,
+  // com o clock baixo para que quase todo salto caia no meio de uma
+  LoRa.setSPIFrequency(100000);
+  LoRa.setDeferredIrq(true);
+  LoRa.receive();
+  receivedLength = 0;
+  radio.resetStats();
+
+  uint32_t bursts = 0;
+  uint8_t modemConfig2 = radio.reg(0x1e);
+
+  start = time_us_64();
+  radio.injectPacket(payload, 64);
+  while (receivedLength == 0 && time_us_64() - start < 2000000) {
+    LoRa.poll();
+    LoRa.resync();
+    bursts++;
+  }
+
+  if (receivedLength != 64 || memcmp(received, payload, 64) != 0 || !hopsMatch(hopTable, 8) ||
+      radio.reg(0x1e) != modemConfig2 || bursts < radio.hopCount()) {
+    printf("falha: saltos no modo adiado (%u permanencias, %u rajadas)\n", (unsigned)radio.hopCount(),
+           (unsigned)bursts);
+    failures++;
+  }
+  LoRa.setDeferredIrq(false);
+  LoRa.setSPIFrequency(LORA_DEFAULT_SPI_FREQUENCY);
+  LoRa.onReceive(NULL);
+  LoRa.idle();
+  LoRa.disableFhss();
+  LoRa.setFrequency(915E6);
+
+  return failures;
+}
+
+// varredura com CAD: quatro canais, o preâmbulo longo cobre uma volta inteira
+static int testScan()
+{
+  uint64_t start;
+  int failures = 0;
+
+  static const long scanTable[] = { 902300000, 902500000, 902700000, 902900000 };
+  int scanReceived = 0;
+
+  LoRa.setPreambleLength(24);
+  LoRa.onReceive(onReceive);
+  LoRa.startScan(scanTable, 4);
+  radio.resetStats();
+
+  start = time_us_64();
+  for (int i = 0; i < 8; i++) {
+    uint64_t sent = time_us_64();
+
+    // instantes diferentes em relação à varredura
+    sleep_us(1000 + 370 * i);
+    receivedLength = 0;
+    payload[0] = (uint8_t)i;
+    radio.injectPacketOn(scanTable[i % 4], payload, 16);
+    while (receivedLength == 0 && time_us_64() - sent < 500000) {
+      sleep_ms(1);
+      LoRa.poll();
+    }
+    scanReceived += receivedLength == 16 && received[0] == i;
+  }
+  payload[0] = 0;
+  failures += report("rx: varredura 4 canais", start, 212);
+
+  for (int i = 0; i < 4; i++) {
+    if (LoRa.scanStats(i).received != 2) {
+      scanReceived = -1;
+    }
+  }
+  if (scanReceived != 8) {
+    printf("falha: varredura (%d de 8 pacotes)\n", scanReceived);
+    failures++;
+  }
+
+  // preâmbulo curto demais: detecções sem pacote terminam em timeout e a varredura continua
+  const LoRaScanStats &missed = LoRa.scanStats(1);
+  uint32_t detectedBefore = missed.detected;
+
+  LoRa.setPreambleLength(6);
+  receivedLength = 0;
+  start = time_us_64();
+  radio.injectPacketOn(scanTable[1], payload, 64);
+  while (time_us_64() - start < 200000) {
+    sleep_ms(1);
+    LoRa.poll();
+  }
+  uint32_t cadsBefore = LoRa.scanStats(0).cads;
+  sleep_ms(20);
+  LoRa.poll();
+
+  if (missed.detected == detectedBefore || missed.received != 2 || LoRa.scanStats(0).cads == cadsBefore) {
+    printf("falha: timeout da varredura\n");
+    failures++;
+  }
+
+  LoRa.stopScan();
+  LoRa.onReceive(NULL);
+
+  // contadores ficam após stopScan(); índices fora da lista devolvem uma entrada vazia
+  if (LoRa.scanStats(1).received != 2 || LoRa.scanStats(4).cads != 0 ||
+      LoRa.scanStats(LORA_SCAN_MAX_CHANNELS + 8).cads != 0) {
+    printf("falha: scanStats fora da lista\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// escuta de baixo consumo: um CAD a cada 50 ms, rádio dormindo no resto do tempo.
+// O modelo usa o preâmbulo do receptor para o quadro, então os dois lados usam o mesmo.
+static int testLowPower()
+{
+  uint64_t start;
+  int failures = 0;
+
+  const uint32_t wakeInterval = 50000;
+
+  LoRa.setWakePreamble(wakeInterval);
+  radio.resetStats();
+
+  start = time_us_64();
+  int idleLength = LoRa.receiveLowPower(wakeInterval, 1000000);
+  uint64_t idleTime = time_us_64() - start;
+  uint64_t listened = radio.listenTimeUs();
+  failures += report("rx: baixo consumo, 1 s ocioso", start, 101);
+
+  printf("  rádio escutando %.1f%% do tempo\n", 100.0 * listened / idleTime);
+  if (idleLength != 0 || listened * 10 > idleTime) {
+    printf("falha: escuta de baixo consumo ociosa\n");
+    failures++;
+  }
+
+  start = time_us_64();
+  uint64_t sentAt = start + 123000;
+  radio.injectPacketAt(sentAt, payload, 16);
+  int wakeLength = LoRa.receiveLowPower(wakeInterval, 1000000);
+  uint64_t latency = time_us_64() - sentAt;
+  int wakeRead = LoRa.readPacket(received, sizeof(received));
+  failures += report("rx: baixo consumo, 16B", start, 28);
+
+  if (wakeLength != 16 || wakeRead != 16 || memcmp(received, payload, 16) != 0 ||
+      latency > wakeInterval + LoRa.timeOnAir(16)) {
+    printf("falha: escuta de baixo consumo (%d bytes, latencia %llu us)\n", wakeLength,
+           (unsigned long long)latency);
+    failures++;
+  }
+  LoRa.setPreambleLength(8);
+
+  return failures;
+}
+
+// janela RX_SINGLE de 12 símbolos: sem quadro, o DIO1 fecha a janela sem poll()
+static int testReceiveWindow()
+{
+  uint64_t start;
+  int failures = 0;
+
+  const int windowSymbols = 12;
+  uint32_t windowUs = windowSymbols * LoRa.symbolTime();
+
+  LoRa.onReceive(onReceive);
+  LoRa.onRxTimeout(onRxTimeout);
+  rxTimeouts = 0;
+  radio.resetStats();
+
+  start = time_us_64();
+  LoRa.receiveWindow(windowSymbols);
+  while (rxTimeouts == 0 && time_us_64() - start < 100000) {
+    sleep_us(10);
+  }
+  uint64_t windowClosed = time_us_64() - start;
+  failures += report("rx: janela vazia (DIO1)", start, 6);
+
+  if (rxTimeouts != 1 || windowClosed > windowUs + LoRa.symbolTime()) {
+    printf("falha: janela RX_SINGLE (%d timeouts em %llu us)\n", rxTimeouts,
+           (unsigned long long)windowClosed);
+    failures++;
+  }
+
+  // quadro dentro da janela: onReceive, nenhum timeout
+  rxTimeouts = 0;
+  receivedLength = 0;
+  start = time_us_64();
+  LoRa.receiveWindow(windowSymbols);
+  sleep_us(windowUs / 2);
+  radio.injectPacket(payload, 16);
+  while (receivedLength == 0 && time_us_64() - start < 100000) {
+    sleep_us(10);
+  }
+  sleep_us(windowUs);
+  failures += report("rx: janela com 16B", start, 9);
+
+  if (receivedLength != 16 || rxTimeouts != 0) {
+    printf("falha: quadro na janela RX_SINGLE\n");
+    failures++;
+  }
+
+  // sem DIO1 a janela é fechada por poll() ao fim do prazo
+  gpio_set_irq_enabled(BENCH_DIO1_PIN, GPIO_IRQ_EDGE_RISE, false);
+  LoRa.setPins(LORA_DEFAULT_SS_PIN, LORA_DEFAULT_RESET_PIN, LORA_DEFAULT_DIO0_PIN);
+  rxTimeouts = 0;
+  start = time_us_64();
+  LoRa.receiveWindow(windowSymbols);
+  while (rxTimeouts == 0 && time_us_64() - start < 100000) {
+    sleep_us(100);
+    LoRa.poll();
+  }
+  windowClosed = time_us_64() - start;
+  failures += report("rx: janela vazia (poll)", start, 5);
+
+  if (rxTimeouts != 1 || windowClosed > windowUs + 2 * LoRa.symbolTime() + 100) {
+    printf("falha: janela RX_SINGLE sem DIO1 (%llu us)\n", (unsigned long long)windowClosed);
+    failures++;
+  }
+
+  LoRa.setPins(LORA_DEFAULT_SS_PIN, LORA_DEFAULT_RESET_PIN, LORA_DEFAULT_DIO0_PIN, BENCH_DIO1_PIN);
+  LoRa.onRxTimeout(NULL);
+
+  return failures;
+}
+
+// recepção em fluxo: o payload vai para o slab durante o quadro, o RxDone só lê o final
+static int testStreamingRx()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.onReceive(onPacketDrained);
+  LoRa.enablePacketPool();
+  LoRa.receive();
+  uint64_t fullShort = drainLatency(payload, 16);
+  uint64_t fullLong = drainLatency(payload, 240);
+
+  LoRa.enableStreamingRx();
+  radio.resetStats();
+  start = time_us_64();
+  uint64_t streamShort = drainLatency(payload, 16);
+  uint64_t streamLong = drainLatency(payload, 240);
+  failures += report("rx: fluxo 16B + 240B", start, 1385);
+  LoRa.disableStreamingRx();
+
+  printf("  RxDone -> RAM: 16B %llu us, 240B %llu us (sem fluxo: %llu us, %llu us)\n",
+         (unsigned long long)streamShort, (unsigned long long)streamLong,
+         (unsigned long long)fullShort, (unsigned long long)fullLong);
+  // um quadro relido inteiro no RxDone indica endereço ou tamanho errado no fluxo
+  if (streamShort == UINT64_MAX || streamLong == UINT64_MAX || fullLong == UINT64_MAX ||
+      streamLong > streamShort + 16 || streamLong * 4 > fullLong || LoRa.streamFallbacks() != 0 ||
+      LoRa.packetPool().freeSlabs() != LORA_PACKET_POOL_SIZE) {
+    printf("falha: recepção em fluxo\n");
+    failures++;
+  }
+
+  LoRa.disablePacketPool();
+  LoRa.onReceive(NULL);
+
+  return failures;
+}
+
+// listen-before-talk: o canal está ocupado por um quadro de 100 bytes quando a fila quer transmitir
+static int testLbt()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRa.idle();
+  LoRa.enableLbt();
+  radio.resetStats();
+
+  start = time_us_64();
+  radio.injectPacket(payload, 100);
+  uint64_t busyUntil = start + radio.timeOnAirUs(100);
+  sleep_ms(5);
+  uint64_t enqueuedAt = time_us_64();
+  LoRa.enqueue(payload, 16);
+  uint64_t enqueueUs = time_us_64() - enqueuedAt;
+  uint64_t lbtTx = waitTxStart(1000000);
+  sleep_us(LoRa.timeOnAir(16) + 1000);
+  failures += report("tx: LBT, canal ocupado", start, 58);
+
+  const LoRaLbtStats &lbt = LoRa.lbtStats();
+
+  printf("  %lu CADs, %lu ocupados, %llu us de backoff, transmitiu %llu us após o canal liberar\n",
+         (unsigned long)lbt.cads, (unsigned long)lbt.busy, (unsigned long long)lbt.backoffUs,
+         (unsigned long long)(lbtTx - busyUntil));
+  if (!lbtTx || lbtTx < busyUntil || lbt.busy < 2 || lbt.cads != lbt.busy + 1 ||
+      lbt.sentAfter[lbt.cads - 1] != 1 || lbt.dropped != 0 || enqueueUs > 1000) {
+    printf("falha: LBT com canal ocupado\n");
+    failures++;
+  }
+
+  // duas tentativas com janela fixa não bastam para um quadro de 255 bytes: o quadro é descartado
+  LoRaLbtConfig shortLbt;
+  shortLbt.maxAttempts = 2;
+  shortLbt.maxExponent = 1;
+  LoRa.enableLbt(shortLbt);
+
+  start = time_us_64();
+  radio.injectPacket(payload, 255);
+  sleep_ms(5);
+  LoRa.enqueue(payload, 16);
+  uint64_t droppedTx = waitTxStart(200000);
+  sleep_ms(300);
+
+  if (droppedTx || lbt.dropped != 1 || lbt.cads != 2 || LoRa.txQueueDepth() != 0) {
+    printf("falha: LBT descarte após %d tentativas\n", shortLbt.maxAttempts);
+    failures++;
+  }
+
+  // interferência sem preâmbulo LoRa: o CAD não vê, a confirmação por RSSI sim
+  LoRaLbtConfig rssiLbt;
+  rssiLbt.rssiThreshold = -90;
+  LoRa.enableLbt(rssiLbt);
+  radio.setChannelRssi(-60);
+
+  uint32_t txBeforeRssi = radio.txCount();
+  LoRa.enqueue(payload, 16);
+  sleep_ms(20);
+  bool interferenceTx = radio.txCount() != txBeforeRssi;
+  radio.setChannelRssi(-110);
+  uint64_t rssiTx = waitTxStart(1000000);
+  sleep_us(LoRa.timeOnAir(16) + 1000);
+
+  if (interferenceTx || !rssiTx || lbt.rssiBusy < 1 || lbt.busy != 0 ||
+      lbt.sentAfter[lbt.rssiBusy] != 1) {
+    printf("falha: LBT com confirmação por RSSI\n");
+    failures++;
+  }
+
+  LoRa.disableLbt();
+
+  return failures;
+}
+
+// transporte com fragmentação: 3000 bytes do rádio A para o B, com quatro fragmentos perdidos
+static int testTransfer()
+{
+  uint64_t start;
+  int failures = 0;
+
+  static uint8_t blob[3000];
+
+  for (size_t i = 0; i < sizeof(blob); i++) {
+    blob[i] = (uint8_t)(i * 7 + (i >> 8));
+  }
+
+  LoRaB.setSPI(*spi1);
+  LoRaB.setPins(13, 14, 15);
+  if (!LoRaB.begin(915E6)) {
+    printf("falha: begin do rádio B\n");
+    return 1;
+  }
+  LoRaB.setSPIFrequency(LORA_DEFAULT_SPI_FREQUENCY);
+  for (LoRaClass *node : { &LoRa, &LoRaB }) {
+    node->setFrequency(915E6);
+    node->setSpreadingFactor(7);
+    node->setSignalBandwidth(125E3);
+    node->setCodingRate4(5);
+    node->setPreambleLength(8);
+    node->setSyncWord(0x34);
+    node->enableCrc();
+  }
+
+  LoRaTransfer sender(LoRa);
+  LoRaTransfer receiver(LoRaB);
+
+  sender.begin();
+  receiver.begin();
+
+  // o 25º quadro é o último fragmento, que pede o ACK: a primeira rodada termina em timeout
+  radioB.dropFrames((1u << 2) | (1u << 7) | (1u << 8) | (1u << 24));
+  radio.resetStats();
+
+  start = time_us_64();
+  sender.send(blob, sizeof(blob));
+  while (sender.state() == LORA_TRANSFER_SENDING && time_us_64() - start < 60000000) {
+    sender.poll();
+    receiver.poll();
+    sleep_ms(1);
+  }
+  failures += report("transporte: 3000B, 4 perdas", start, 282);
+
+  const LoRaTransferStats &transfer = sender.stats();
+
+  printf("  %lu fragmentos, %lu reenviados, %lu rodadas, %lu timeouts\n",
+         (unsigned long)transfer.fragmentsSent, (unsigned long)transfer.retransmitted,
+         (unsigned long)transfer.rounds, (unsigned long)transfer.timeouts);
+  if (sender.state() != LORA_TRANSFER_DONE || receiver.available() != sizeof(blob) ||
+      memcmp(receiver.data(), blob, sizeof(blob)) != 0 || transfer.fragmentsSent != 25 ||
+      transfer.retransmitted != 4 || transfer.timeouts != 1) {
+    printf("falha: transporte com fragmentação\n");
+    failures++;
+  }
+
+  receiver.release();
+  sender.end();
+  receiver.end();
+
+  return failures;
+}
+
+// enlace confiável: 64 mensagens de 32 bytes, pare-e-espere (janela 1) contra janela cheia
+static int testLink()
+{
+  uint64_t start;
+  int failures = 0;
+
+  const int linkMessages = 64;
+  const size_t linkSize = 32;
+  const uint8_t linkWindows[] = { 1, LORA_LINK_MAX_WINDOW };
+  const uint32_t linkBudgets[] = { 1154, 650 };
+  double linkCapacity = (double)linkSize / LoRa.timeOnAir(LORA_LINK_HEADER_SIZE + linkSize);
+  double linkGoodput[2];
+
+  for (int w = 0; w < 2; w++) {
+    LoRaLink nodeA(0xaa, LoRa);
+    LoRaLink nodeB(0xbb, LoRaB);
+    char step[32];
+
+    nodeA.setWindow(linkWindows[w]);
+    nodeB.onMessage(onLinkMessage);
+    nodeA.begin();
+    nodeB.begin();
+
+    start = time_us_64();
+    uint64_t elapsed = linkRun(nodeA, nodeB, linkMessages, linkSize);
+    snprintf(step, sizeof(step), "enlace: janela %d", linkWindows[w]);
+    failures += report(step, start, linkBudgets[w]);
+
+    linkGoodput[w] = (double)linkMessages * linkSize / elapsed;
+    printf("  %.0f B/s, %.0f%% da capacidade do canal, RTT %lu us, RTO %lu us\n",
+           linkGoodput[w] * 1e6, 100 * linkGoodput[w] / linkCapacity,
+           (unsigned long)nodeA.rtt(0xbb), (unsigned long)nodeA.rto(0xbb));
+    if (nodeB.stats().delivered != linkMessages || linkOutOfOrder != 0 ||
+        nodeA.stats().retransmitted != 0 || nodeA.pending(0xbb) != 0) {
+      printf("falha: enlace com janela %d\n", linkWindows[w]);
+      failures++;
+    }
+
+    nodeA.end();
+    nodeB.end();
+  }
+
+  if (linkGoodput[1] < 0.9 * linkCapacity || linkGoodput[1] <= linkGoodput[0]) {
+    printf("falha: vazão do enlace com janela\n");
+    failures++;
+  }
+
+  // perdas: os dados 2, 5 e 7 (o pedido de ACK da primeira rajada) não chegam ao B, e o
+  // segundo ACK não chega ao A; só os buracos vão de novo ao ar
+  {
+    LoRaLink nodeA(0xaa, LoRa);
+    LoRaLink nodeB(0xbb, LoRaB);
+
+    nodeB.onMessage(onLinkMessage);
+    nodeA.begin();
+    nodeB.begin();
+    radioB.dropFrames((1u << 2) | (1u << 5) | (1u << 7));
+    radio.dropFrames(1u << 1);
+
+    start = time_us_64();
+    linkRun(nodeA, nodeB, 24, linkSize);
+    failures += report("enlace: 24 mensagens, 4 perdas", start, 296);
+
+    const LoRaLinkStats &link = nodeA.stats();
+
+    printf("  %lu enviados, %lu reenviados, %lu timeouts, %lu duplicados no B\n",
+           (unsigned long)link.sent, (unsigned long)link.retransmitted,
+           (unsigned long)link.timeouts, (unsigned long)nodeB.stats().duplicates);
+    if (nodeB.stats().delivered != 24 || linkOutOfOrder != 0 || link.dropped != 0 ||
+        link.sent != 24 || link.retransmitted != 4 || link.timeouts != 2 ||
+        nodeB.stats().duplicates != 1) {
+      printf("falha: enlace com perdas\n");
+      failures++;
+    }
+
+    nodeA.end();
+    nodeB.end();
+  }
+
+  // destino que nunca responde: a mensagem é abandonada no LORA_LINK_MAX_RETRIES-ésimo timeout
+  {
+    LoRaLink nodeA(0xaa, LoRa);
+    uint8_t message[8] = { 0 };
+
+    nodeA.begin();
+    nodeA.send(0xcc, message, sizeof(message));
+
+    start = time_us_64();
+    while (nodeA.pending(0xcc) && time_us_64() - start < 60000000) {
+      nodeA.poll();
+      sleep_ms(1);
+    }
+
+    if (nodeA.pending(0xcc) || nodeA.stats().dropped != 1 || nodeA.stats().timeouts != LORA_LINK_MAX_RETRIES) {
+      printf("falha: enlace sem resposta (%lu timeouts)\n", (unsigned long)nodeA.stats().timeouts);
+      failures++;
+    }
+
+    nodeA.end();
+  }
+  LoRaB.end();
+
+  return failures;
+}
+
+// enquadramento binário: a telemetria do LoRa_Duplex montada direto na fila de TX, contra o
+// cabeçalho de 4 bytes e o texto que ele substituiu
+static int testFraming()
+{
+  uint64_t start;
+  int failures = 0;
+
+  constexpr LoRaHeaderLayout frameLayout = { 8, 2, 6 };
+  typedef LoRaMessage<LoRaVarint<uint32_t>, LoRaVarint<int16_t>, LoRaVarint<int16_t>, LoRaVarint<uint16_t>> Telemetry;
+
+  static_assert(frameLayout.size() == 3 && Telemetry::maxSize == 5 + 3 + 3 + 3, "tamanhos do enquadramento");
+
+  const char *asciiMessage = "Olá do dispositivo 0xBB - Msg #37";
+  size_t asciiLength = 4 + strlen(asciiMessage);
+
+  LoRa.idle();
+  radio.resetStats();
+  start = time_us_64();
+
+  uint32_t txBeforeFrame = radio.txCount();
+  uint8_t *slot = LoRa.reserveTx();
+  LoRaFrameWriter writer(slot, LORA_TX_FIFO_SIZE);
+
+  writer.header(frameLayout, { 0xaa, 0xbb, 2, 37 });
+  Telemetry::write(writer, 86400u, (int16_t)-97, (int16_t)-30, (uint16_t)300);
+  bool committed = writer.ok() && LoRa.commitTx(writer.length());
+  sleep_us(LoRa.timeOnAir(writer.length()) + 1000);
+  bool framedTx = radio.txCount() == txBeforeFrame + 1;
+  failures += report("tx: telemetria binária", start, 10);
+
+  uint8_t framed[LORA_TX_FIFO_SIZE];
+  LoRaHeader header;
+  uint32_t uptime;
+  int16_t rssi, snr;
+  uint16_t count;
+
+  for (size_t i = 0; i < writer.length(); i++) {
+    framed[i] = radio.fifo()[(uint8_t)(0x80 + i)];
+  }
+
+  LoRaFrameReader reader(framed, writer.length());
+  bool decoded = reader.header(frameLayout, header) && Telemetry::read(reader, uptime, rssi, snr, count) &&
+                 reader.remaining() == 0;
+
+  printf("  %u bytes contra %u em texto, %lu us no ar contra %lu us\n",
+         (unsigned)writer.length(), (unsigned)asciiLength,
+         (unsigned long)LoRa.timeOnAir(writer.length()), (unsigned long)LoRa.timeOnAir(asciiLength));
+  if (!committed || !framedTx || writer.length() != 11 || framed[2] != 0xa5 || !decoded ||
+      header.destination != 0xaa || header.source != 0xbb || header.flags != 2 || header.sequence != 37 ||
+      uptime != 86400 || rssi != -97 || snr != -30 || count != 300) {
+    printf("falha: telemetria binária\n");
+    failures++;
+  }
+
+  // limites: quadro truncado, visão fora do quadro, varint longo demais para o tipo
+  // e varints que cabem no comprimento mas não no tipo (300 e -200 num byte)
+  static const uint8_t overlong[] = { 0xff, 0xff, 0xff };
+  static const uint8_t wide[] = { 0xac, 0x02 };
+  static const uint8_t negative[] = { 0x8f, 0x03 };
+  LoRaFrameReader truncated(framed, writer.length() - 1);
+  LoRaFrameReader overflow(overlong, sizeof(overlong));
+  LoRaFrameReader tooWide(wide, sizeof(wide));
+  LoRaFrameReader tooNegative(negative, sizeof(negative));
+  uint8_t small;
+  int8_t smallSigned;
+
+  if (!truncated.header(frameLayout, header) || Telemetry::read(truncated, uptime, rssi, snr, count) ||
+      truncated.ok() || !LoRaView(framed, writer.length()).sub(writer.length() - 2, 3).empty() ||
+      overflow.varint(small) || tooWide.varint(small) || tooWide.ok() || tooNegative.varint(smallSigned)) {
+    printf("falha: limites do enquadramento\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// compressão: a mensagem do LoRa_TX com o dicionário pré-compartilhado, pela FIFO do modelo,
+// e um nó sem dicionário enviando em texto puro
+static int testCompression()
+{
+  uint64_t start;
+  int failures = 0;
+
+  static const char dictionary[] = "Transmissor LoRa - Mensagem #";
+  const char *txMessage = "Transmissor LoRa - Mensagem #42";
+  LoRaCompressor compressor(LoRa);
+  LoRaCompressor plainNode(LoRa);
+  uint8_t framed[LORA_COMPRESS_MAX_PAYLOAD];
+  uint8_t inflated[LORA_COMPRESS_MAX_PAYLOAD];
+
+  compressor.setDictionary((const uint8_t *)dictionary, strlen(dictionary));
+
+  LoRa.idle();
+  radio.resetStats();
+  start = time_us_64();
+
+  uint32_t txBeforeCompressed = radio.txCount();
+  compressor.beginPacket();
+  compressor.print(txMessage);
+  bool compressedSent = compressor.endPacket(true);
+  sleep_us(LoRa.timeOnAir(strlen(txMessage)) + 1000);
+  compressedSent = compressedSent && radio.txCount() == txBeforeCompressed + 1;
+  failures += report("tx: mensagem comprimida", start, 10);
+
+  size_t compressedLength = compressor.stats().bytesOut;
+
+  for (size_t i = 0; i < compressedLength; i++) {
+    framed[i] = radio.fifo()[(uint8_t)(0x80 + i)];
+  }
+
+  int inflatedLength = compressor.decode(framed, compressedLength, inflated, sizeof(inflated));
+
+  printf("  %u bytes contra %u, %lu us no ar contra %lu us\n", (unsigned)compressedLength,
+         (unsigned)strlen(txMessage), (unsigned long)LoRa.timeOnAir(compressedLength),
+         (unsigned long)LoRa.timeOnAir(strlen(txMessage)));
+  if (!compressedSent || compressor.stats().compressed != 1 ||
+      compressedLength >= 8 || framed[0] != LORA_COMPRESS_MARKER || inflatedLength != (int)strlen(txMessage) ||
+      memcmp(inflated, txMessage, inflatedLength) != 0) {
+    printf("falha: compressão com dicionário\n");
+    failures++;
+  }
+
+  // sem ganho o quadro sai puro e passa intacto; um payload que começa pelo marcador sai sempre
+  // comprimido; quadros corrompidos são recusados
+  static const uint8_t marked[] = { LORA_COMPRESS_MARKER, 1, 2 };
+  const char *shortText = "ok";
+  uint8_t encoded[LORA_COMPRESS_MAX_PAYLOAD];
+  size_t plainLength = plainNode.encode((const uint8_t *)shortText, 2, encoded, sizeof(encoded));
+  bool passedOk = compressor.decode(encoded, plainLength, inflated, sizeof(inflated)) == 2 &&
+                  memcmp(inflated, shortText, 2) == 0;
+  size_t markedLength = plainNode.encode(marked, sizeof(marked), encoded, sizeof(encoded));
+  int markedDecoded = plainNode.decode(encoded, markedLength, inflated, sizeof(inflated));
+  bool markedOk = markedDecoded == (int)sizeof(marked) && memcmp(inflated, marked, sizeof(marked)) == 0;
+
+  compressedLength = compressor.encode((const uint8_t *)txMessage, strlen(txMessage), encoded, sizeof(encoded));
+  bool rejected = compressor.decode(encoded, compressedLength - 1, inflated, sizeof(inflated)) < 0 &&
+                  plainNode.decode(encoded, compressedLength, inflated, sizeof(inflated)) < 0;
+
+  if (plainLength != 2 || !passedOk || !markedOk ||
+      plainNode.stats().compressed != 1 || !rejected) {
+    printf("falha: interoperabilidade da compressão\n");
+    failures++;
+  }
+
+  return failures;
+}
+
+// tempo no ar do driver, configurado pelos registradores, e do modelo contra a tabela de
+// referência; depois o modelo contra o driver em toda a faixa, para a temporização do simulador
+static int testTimeOnAir()
+{
+  int failures = 0;
+
+  for (const AirtimeCase &c : airtimeTable) {
+    LoRa.setSpreadingFactor(c.sf);
+    LoRa.setSignalBandwidth(c.bw);
+    LoRa.setCodingRate4(c.cr);
+    LoRa.setPreambleLength(c.preamble);
+    if (c.crc) {
+      LoRa.enableCrc();
+    } else {
+      LoRa.disableCrc();
+    }
+    if (c.implicitHeader) {
+      LoRa.setFixedFrame(c.length);
+    } else {
+      LoRa.disableFixedFrame();
+    }
+
+    uint32_t driver = LoRa.timeOnAir(c.length);
+    uint64_t model = radio.timeOnAirUs(c.length);
+
+    if (driver != c.us || model != c.us) {
+      printf("falha: tempo no ar de %u B em SF%d/%ld Hz, CR 4/%d%s%s: driver %lu us, modelo %llu us, "
+             "datasheet %lu us\n", (unsigned)c.length, c.sf, c.bw, c.cr, c.crc ? "" : ", sem CRC",
+             c.implicitHeader ? ", implícito" : "", (unsigned long)driver, (unsigned long long)model,
+             (unsigned long)c.us);
+      failures++;
+    }
+  }
+
+  LoRa.disableFixedFrame();
+  LoRa.setCodingRate4(5);
+  LoRa.setPreambleLength(8);
+  LoRa.enableCrc();
+
+  static const long bandwidths[] = { 62500, 125000, 250000 };
+  int mismatches = 0;
+
+  for (int sf = 7; sf <= 12; sf++) {
+    for (long bw : bandwidths) {
+      LoRa.setSpreadingFactor(sf);
+      LoRa.setSignalBandwidth(bw);
+
+      for (size_t length = 1; length <= 255; length += 37) {
+        int64_t diff = (int64_t)LoRa.timeOnAir(length) - (int64_t)radio.timeOnAirUs(length);
+
+        if (diff < -1 || diff > 1) {
+          mismatches++;
+        }
+      }
+    }
+  }
+  if (mismatches) {
+    printf("falha: tempo no ar diverge do modelo em %d casos\n", mismatches);
+    failures++;
+  }
+
+  return failures;
+}
+
+// dois rádios no spi0: a ISR de um lê o pacote enquanto a thread escreve rajadas no outro
+static int testSharedBus()
+{
+  uint64_t start;
+  int failures = 0;
+
+  LoRaC.setPins(20, -1, 22);
+  if (!LoRaC.begin(915E6)) {
+    printf("falha: begin do rádio C\n");
+    return 1;
+  }
+  LoRaC.setSPIFrequency(LORA_DEFAULT_SPI_FREQUENCY);
+  LoRaC.setSpreadingFactor(7);
+  LoRaC.onReceive(onSharedReceive);
+  LoRaC.receive();
+  LoRa.idle();
+
+  uint32_t collisions = sim_bus_collisions();
+  bool fifoOk = true;
+  int bursts = 0;
+
+  start = time_us_64();
+  radioC.injectPacket(payload, sizeof(payload));
+  while (sharedLength == 0 && time_us_64() - start < 2000000) {
+    LoRa.beginPacket();
+    LoRa.write(payload, sizeof(payload));
+    fifoOk = fifoOk && fifoMatches(payload, sizeof(payload), radio.reg(0x0e));
+    bursts++;
+  }
+
+  printf("  %d rajadas de 255B durante a recepção, %lu colisões\n", bursts,
+         (unsigned long)(sim_bus_collisions() - collisions));
+  if (sharedLength != sizeof(payload) || memcmp(sharedReceived, payload, sizeof(payload)) != 0 || !fifoOk ||
+      sim_bus_collisions() != collisions || bursts < 2) {
+    printf("falha: rádios no mesmo barramento\n");
+    failures++;
+  }
+
+  LoRaC.sleep();
+  LoRa.idle();
+
+  return failures;
+}
+
+// etapas na ordem em que rodam, cada uma parte do estado em que a anterior deixou o rádio
+static const struct {
+  const char *name;
+  int (*run)();
+} tests[] = {
+  { "begin", testBegin },
+  { "tx", testTx },
+  { "rx", testRx },
+  { "DMA", testDma },
+  { "fila de TX", testTxQueue },
+  { "IRQ adiada", testDeferredIrq },
+  { "pool de pacotes", testPacketPool },
+  { "PacketInfo", testPacketInfo },
+  { "motor no core1", testEngine },
+  { "ciclo de trabalho", testDutyCycle },
+  { "quadro fixo", testFixedFrame },
+  { "FHSS", testFhss },
+  { "varredura", testScan },
+  { "baixo consumo", testLowPower },
+  { "janela de recepção", testReceiveWindow },
+  { "recepção em fluxo", testStreamingRx },
+  { "listen-before-talk", testLbt },
+  { "transporte", testTransfer },
+  { "enlace", testLink },
+  { "enquadramento", testFraming },
+  { "compressão", testCompression },
+  { "tempo no ar", testTimeOnAir },
+  { "barramento compartilhado", testSharedBus },
+};
+
+int main()
+{
+  int failures = 0;
+
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t)i;
+  }
+
+  printf("%-28s %8s %8s %8s %10s\n", "etapa", "transac", "bytes", "limite", "tempo_us");
+
+  for (const auto &test : tests) {
+    int failed = test.run();
+
+    if (failed) {
+      printf("falha: %s (%d verificações)\n", test.name, failed);
+      failures += failed;
+
+      // sem o rádio inicializado as outras etapas não dizem nada
+      if (test.run == testBegin) {
+        break;
+      }
+    }
+  }
+
+  return failures;
+}
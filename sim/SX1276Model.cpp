@@ -0,0 +1,726 @@
+#include "SX1276Model.h"
+#include "pico_sim.h"
+
+#include <math.h>
+#include <string.h>
+
+// registers
+#define REG_FIFO                 0x00
+#define REG_OP_MODE              0x01
+#define REG_FRF_MSB              0x06
+#define REG_FRF_MID              0x07
+#define REG_FRF_LSB              0x08
+#define REG_PA_CONFIG            0x09
+#define REG_OCP                  0x0b
+#define REG_LNA                  0x0c
+#define REG_FIFO_ADDR_PTR        0x0d
+#define REG_FIFO_TX_BASE_ADDR    0x0e
+#define REG_FIFO_RX_BASE_ADDR    0x0f
+#define REG_FIFO_RX_CURRENT_ADDR 0x10
+#define REG_IRQ_FLAGS_MASK       0x11
+#define REG_IRQ_FLAGS            0x12
+#define REG_RX_NB_BYTES          0x13
+#define REG_MODEM_STAT           0x18
+#define REG_PKT_SNR_VALUE        0x19
+#define REG_PKT_RSSI_VALUE       0x1a
+#define REG_RSSI_VALUE           0x1b
+#define REG_HOP_CHANNEL          0x1c
+#define REG_MODEM_CONFIG_1       0x1d
+#define REG_MODEM_CONFIG_2       0x1e
+#define REG_SYMB_TIMEOUT_LSB     0x1f
+#define REG_PREAMBLE_MSB         0x20
+#define REG_PREAMBLE_LSB         0x21
+#define REG_PAYLOAD_LENGTH       0x22
+#define REG_MAX_PAYLOAD_LENGTH   0x23
+#define REG_HOP_PERIOD           0x24
+#define REG_FIFO_RX_BYTE_ADDR    0x25
+#define REG_MODEM_CONFIG_3       0x26
+#define REG_FREQ_ERROR_MSB       0x28
+#define REG_FREQ_ERROR_MID       0x29
+#define REG_FREQ_ERROR_LSB       0x2a
+#define REG_RSSI_WIDEBAND        0x2c
+#define REG_DETECTION_OPTIMIZE   0x31
+#define REG_INVERTIQ             0x33
+#define REG_DETECTION_THRESHOLD  0x37
+#define REG_SYNC_WORD            0x39
+#define REG_INVERTIQ2            0x3b
+#define REG_DIO_MAPPING_1        0x40
+#define REG_VERSION              0x42
+#define REG_PA_DAC               0x4d
+
+// modes
+#define MODE_LONG_RANGE_MODE     0x80
+#define MODE_SLEEP               0x00
+#define MODE_STDBY               0x01
+#define MODE_TX                  0x03
+#define MODE_RX_CONTINUOUS       0x05
+#define MODE_RX_SINGLE           0x06
+#define MODE_CAD                 0x07
+
+// IRQ masks
+#define IRQ_CAD_DETECTED_MASK      0x01
+#define IRQ_FHSS_CHANGE_MASK       0x02
+#define IRQ_CAD_DONE_MASK          0x04
+#define IRQ_TX_DONE_MASK           0x08
+#define IRQ_VALID_HEADER_MASK      0x10
+#define IRQ_PAYLOAD_CRC_ERROR_MASK 0x20
+#define IRQ_RX_DONE_MASK           0x40
+#define IRQ_RX_TIMEOUT_MASK        0x80
+
+static const long bandwidths[] = {
+  7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000
+};
+
+static inline uint64_t earliest(uint64_t a, uint64_t b)
+{
+  if (a == 0) return b;
+  if (b == 0) return a;
+  return a < b ? a : b;
+}
+
+SX1276Model::SX1276Model(spi_inst_t *spi, uint ss, int dio0, int dio1) :
+  _spi(spi),
+  _ss(ss),
+  _dio0(dio0),
+  _dio1(dio1)
+{
+  reset();
+  resetStats();
+  sim_attach_radio(this);
+}
+
+SX1276Model::~SX1276Model()
+{
+  sim_detach_radio(this);
+}
+
+void SX1276Model::reset()
+{
+  memset(_regs, 0, sizeof(_regs));
+  memset(_fifo, 0, sizeof(_fifo));
+
+  // LoRa page power-on defaults (SX1276 datasheet, table 41)
+  _regs[REG_OP_MODE] = 0x09;
+  _regs[REG_FRF_MSB] = 0x6c;
+  _regs[REG_FRF_MID] = 0x80;
+  _regs[REG_FRF_LSB] = 0x00;
+  _regs[REG_PA_CONFIG] = 0x4f;
+  _regs[REG_OCP] = 0x2b;
+  _regs[REG_LNA] = 0x20;
+  _regs[REG_FIFO_TX_BASE_ADDR] = 0x80;
+  _regs[REG_FIFO_RX_BASE_ADDR] = 0x00;
+  _regs[REG_MODEM_CONFIG_1] = 0x72;
+  _regs[REG_MODEM_CONFIG_2] = 0x70;
+  _regs[REG_SYMB_TIMEOUT_LSB] = 0x64;
+  _regs[REG_PREAMBLE_LSB] = 0x08;
+  _regs[REG_PAYLOAD_LENGTH] = 0x01;
+  _regs[REG_MAX_PAYLOAD_LENGTH] = 0xff;
+  _regs[REG_DETECTION_OPTIMIZE] = 0xc3;
+  _regs[REG_INVERTIQ] = 0x27;
+  _regs[REG_DETECTION_THRESHOLD] = 0x0a;
+  _regs[REG_SYNC_WORD] = 0x12;
+  _regs[REG_INVERTIQ2] = 0x1d;
+  _regs[REG_VERSION] = 0x12;
+  _regs[REG_PA_DAC] = 0x84;
+
+  _selected = false;
+  _frameIndex = 0;
+  _address = 0;
+  _write = false;
+
+  _rxWritePtr = 0;
+  _rxHeaderAt = 0;
+  _rxStart = 0;
+  _rxWritten = 0;
+
+  _txDoneAt = 0;
+  _cadDoneAt = 0;
+  _validHeaderAt = 0;
+  _rxDoneAt = 0;
+  _rxTimeoutAt = 0;
+  _rxLength = 0;
+  _cadStartAt = 0;
+  _air.length = 0;
+  _air.end = 0;
+  _hopAt = 0;
+  _injectAt = 0;
+  _hopEndAt = 0;
+  _hopCount = 0;
+  _frequencyError = 0;
+  _channelRssi = -110;
+  _dropMask = 0;
+
+  _dio0Level = false;
+  _dio1Level = false;
+  updateDio();
+}
+
+void SX1276Model::resetStats()
+{
+  _spiTransactions = 0;
+  _spiBytes = 0;
+  _txCount = 0;
+  _rxCount = 0;
+  _listenUs = 0;
+  _modeSince = sim_time_us();
+}
+
+uint64_t SX1276Model::listenTimeUs() const
+{
+  uint8_t m = mode();
+
+  if (m == MODE_RX_CONTINUOUS || m == MODE_RX_SINGLE || m == MODE_CAD) {
+    return _listenUs + (sim_time_us() - _modeSince);
+  }
+
+  return _listenUs;
+}
+
+uint32_t SX1276Model::frf() const
+{
+  return ((uint32_t)_regs[REG_FRF_MSB] << 16) | ((uint32_t)_regs[REG_FRF_MID] << 8) | _regs[REG_FRF_LSB];
+}
+
+int SX1276Model::spreadingFactor() const
+{
+  return _regs[REG_MODEM_CONFIG_2] >> 4;
+}
+
+long SX1276Model::signalBandwidth() const
+{
+  uint8_t bw = _regs[REG_MODEM_CONFIG_1] >> 4;
+
+  return bw < 10 ? bandwidths[bw] : bandwidths[9];
+}
+
+uint64_t SX1276Model::symbolTimeUs() const
+{
+  return ((uint64_t)1000000 << spreadingFactor()) / signalBandwidth();
+}
+
+uint64_t SX1276Model::timeOnAirUs(size_t payloadLength) const
+{
+  // SX1276 datasheet, 4.1.1.7 Time on air
+  int sf = spreadingFactor();
+  int cr = (_regs[REG_MODEM_CONFIG_1] >> 1) & 0x07;
+  int ih = (_regs[REG_MODEM_CONFIG_1] & 0x01) || sf == 6;
+  int crc = (_regs[REG_MODEM_CONFIG_2] >> 2) & 0x01;
+  int de = (_regs[REG_MODEM_CONFIG_3] >> 3) & 0x01;
+  int preamble = (_regs[REG_PREAMBLE_MSB] << 8) | _regs[REG_PREAMBLE_LSB];
+
+  double tsym = (double)(1L << sf) / signalBandwidth();
+  double tpreamble = (preamble + 4.25) * tsym;
+
+  double numerator = 8.0 * payloadLength - 4.0 * sf + 28 + 16 * crc - 20 * ih;
+  double symbols = ceil(numerator / (4.0 * (sf - 2 * de))) * (cr + 4);
+  if (symbols < 0) {
+    symbols = 0;
+  }
+
+  return (uint64_t)((tpreamble + (8 + symbols) * tsym) * 1e6 + 0.5);
+}
+
+void SX1276Model::select()
+{
+  _selected = true;
+  _frameIndex = 0;
+  _spiTransactions++;
+}
+
+void SX1276Model::deselect()
+{
+  _selected = false;
+}
+
+uint8_t SX1276Model::transfer(uint8_t value)
+{
+  uint8_t response = 0x00;
+
+  _spiBytes++;
+
+  if (_frameIndex == 0) {
+    _address = value & 0x7f;
+    _write = (value & 0x80) != 0;
+  } else {
+    if (_write) {
+      writeRegister(_address, value);
+    } else {
+      response = readRegister(_address);
+    }
+
+    // burst access auto-increments, except on the FIFO
+    if (_address != REG_FIFO) {
+      _address = (_address + 1) & 0x7f;
+    }
+  }
+
+  _frameIndex++;
+
+  return response;
+}
+
+uint8_t SX1276Model::readRegister(uint8_t address)
+{
+  static uint32_t noise = 0x2545f491;
+
+  switch (address) {
+  case REG_FIFO: {
+    streamToNow();
+    uint8_t value = _fifo[_regs[REG_FIFO_ADDR_PTR]];
+    _regs[REG_FIFO_ADDR_PTR]++;
+    return value;
+  }
+  case REG_FIFO_RX_BYTE_ADDR:
+    // address of the last byte the receiver wrote, not of the next one
+    streamToNow();
+    return (uint8_t)(_rxWritePtr - 1);
+  case REG_RSSI_VALUE:
+    return (uint8_t)(_channelRssi + (frf() < 0x834000 ? 164 : 157));
+  case REG_RSSI_WIDEBAND:
+    noise = noise * 1664525 + 1013904223;
+    return (uint8_t)(noise >> 24);
+  }
+
+  return _regs[address];
+}
+
+void SX1276Model::writeRegister(uint8_t address, uint8_t value)
+{
+  switch (address) {
+  case REG_FIFO:
+    // the LoRa FIFO can only be filled in standby, other writes are lost
+    if (mode() == MODE_STDBY) {
+      _fifo[_regs[REG_FIFO_ADDR_PTR]] = value;
+    }
+    _regs[REG_FIFO_ADDR_PTR]++;
+    return;
+  case REG_OP_MODE:
+    _regs[REG_OP_MODE] = (value & 0xf8) | mode();
+    setMode(value & 0x07);
+    return;
+  case REG_IRQ_FLAGS:
+    // write one to clear
+    _regs[REG_IRQ_FLAGS] &= ~value;
+    updateDio();
+    return;
+  case REG_FIFO_RX_CURRENT_ADDR:
+  case REG_RX_NB_BYTES:
+  case REG_MODEM_STAT:
+  case REG_PKT_SNR_VALUE:
+  case REG_PKT_RSSI_VALUE:
+  case REG_RSSI_VALUE:
+  case REG_HOP_CHANNEL:
+  case REG_FIFO_RX_BYTE_ADDR:
+  case REG_FREQ_ERROR_MSB:
+  case REG_FREQ_ERROR_MID:
+  case REG_FREQ_ERROR_LSB:
+  case REG_RSSI_WIDEBAND:
+  case REG_VERSION:
+    // read-only
+    return;
+  }
+
+  _regs[address] = value;
+
+  if (address == REG_DIO_MAPPING_1 || address == REG_IRQ_FLAGS_MASK) {
+    updateDio();
+  }
+}
+
+void SX1276Model::setMode(uint8_t newMode)
+{
+  uint8_t oldMode = mode();
+
+  _listenUs = listenTimeUs();
+  _modeSince = sim_time_us();
+
+  _regs[REG_OP_MODE] = (_regs[REG_OP_MODE] & 0xf8) | newMode;
+
+  // leaving a mode aborts whatever it had scheduled
+  if (newMode != MODE_TX) {
+    _txDoneAt = 0;
+  }
+  if (newMode != MODE_CAD) {
+    _cadDoneAt = 0;
+  }
+  if (newMode != oldMode) {
+    _hopAt = 0;
+  }
+  if (newMode != MODE_RX_CONTINUOUS && newMode != MODE_RX_SINGLE) {
+    _validHeaderAt = 0;
+    _rxDoneAt = 0;
+    _rxTimeoutAt = 0;
+    _rxHeaderAt = 0;
+  }
+
+  switch (newMode) {
+  case MODE_SLEEP:
+    // FIFO content is lost in sleep
+    memset(_fifo, 0, sizeof(_fifo));
+    break;
+  case MODE_TX:
+    if (oldMode != MODE_TX) {
+      startTx();
+    }
+    break;
+  case MODE_RX_CONTINUOUS:
+  case MODE_RX_SINGLE:
+    if (oldMode != newMode) {
+      startRx(newMode);
+    }
+    break;
+  case MODE_CAD:
+    startCad();
+    break;
+  }
+}
+
+void SX1276Model::startTx()
+{
+  uint64_t now = sim_time_us();
+  uint8_t length = _regs[REG_PAYLOAD_LENGTH];
+  uint8_t payload[256];
+
+  for (int i = 0; i < length; i++) {
+    payload[i] = _fifo[(uint8_t)(_regs[REG_FIFO_TX_BASE_ADDR] + i)];
+  }
+
+  _txDoneAt = now + timeOnAirUs(length);
+  if (_txDoneAt == 0) {
+    _txDoneAt = 1;
+  }
+  _txCount++;
+  startHopping(now, _txDoneAt);
+
+  // everyone tuned to the same channel hears the frame
+  for (size_t i = 0; SX1276Model *other = sim_radio(i); i++) {
+    if (other != this && other->hears(*this)) {
+      other->beginReception(payload, length, now, frf(), -60, 9.0f, false);
+    }
+  }
+}
+
+void SX1276Model::startRx(uint8_t rxMode)
+{
+  _rxWritePtr = _regs[REG_FIFO_RX_BASE_ADDR];
+  _rxLength = 0;
+
+  if (rxMode == MODE_RX_SINGLE) {
+    int symbols = ((_regs[REG_MODEM_CONFIG_2] & 0x03) << 8) | _regs[REG_SYMB_TIMEOUT_LSB];
+
+    _rxTimeoutAt = sim_time_us() + symbols * symbolTimeUs();
+  }
+
+  lockAirFrame();
+}
+
+void SX1276Model::startCad()
+{
+  // roughly two symbols of preamble correlation
+  _cadStartAt = sim_time_us();
+  _cadDoneAt = _cadStartAt + 2 * symbolTimeUs();
+}
+
+bool SX1276Model::hears(const SX1276Model &other) const
+{
+  if (mode() == MODE_SLEEP) {
+    return false;
+  }
+
+  return frf() == other.frf() &&
+         spreadingFactor() == other.spreadingFactor() &&
+         signalBandwidth() == other.signalBandwidth() &&
+         _regs[REG_SYNC_WORD] == other._regs[REG_SYNC_WORD];
+}
+
+void SX1276Model::injectPacket(const uint8_t *buffer, size_t size, int rssi, float snr, bool crcError)
+{
+  beginReception(buffer, size, sim_time_us(), frf(), rssi, snr, crcError);
+}
+
+void SX1276Model::injectPacketAt(uint64_t time, const uint8_t *buffer, size_t size)
+{
+  if (size > sizeof(_injectBuffer)) {
+    size = sizeof(_injectBuffer);
+  }
+
+  memcpy(_injectBuffer, buffer, size);
+  _injectLength = size;
+  _injectAt = time;
+}
+
+void SX1276Model::injectPacketOn(long frequency, const uint8_t *buffer, size_t size, int rssi, float snr)
+{
+  beginReception(buffer, size, sim_time_us(), (uint32_t)(((uint64_t)frequency << 19) / 32000000), rssi, snr, false);
+}
+
+void SX1276Model::beginReception(const uint8_t *buffer, size_t size, uint64_t start, uint32_t frf, int rssi, float snr,
+                                 bool crcError)
+{
+  bool lost = _dropMask & 1;
+
+  _dropMask >>= 1;
+  if (lost) {
+    return;
+  }
+
+  if (size > sizeof(_air.data)) {
+    size = sizeof(_air.data);
+  }
+
+  memcpy(_air.data, buffer, size);
+  _air.length = size;
+  _air.start = start;
+  _air.end = start + timeOnAirUs(size);
+  _air.frf = frf;
+  _air.rssi = rssi;
+  _air.snr = snr;
+  _air.crcError = crcError;
+
+  lockAirFrame();
+}
+
+void SX1276Model::lockAirFrame()
+{
+  uint8_t m = mode();
+  uint64_t now = sim_time_us();
+
+  if ((m != MODE_RX_CONTINUOUS && m != MODE_RX_SINGLE) || _rxDoneAt != 0) {
+    // not listening, or busy with another frame
+    return;
+  }
+
+  if (_air.frf != frf() || now >= _air.end) {
+    // nothing on this channel
+    return;
+  }
+
+  uint64_t tsym = symbolTimeUs();
+  int preamble = (_regs[REG_PREAMBLE_MSB] << 8) | _regs[REG_PREAMBLE_LSB];
+
+  // the detector needs about four preamble symbols to lock
+  if (now > _air.start + (uint64_t)(preamble > 4 ? preamble - 4 : 0) * tsym) {
+    return;
+  }
+
+  memcpy(_rxBuffer, _air.data, _air.length);
+  _rxLength = _air.length;
+  _rxRssi = _air.rssi;
+  _rxSnr = _air.snr;
+  _rxCrcError = _air.crcError;
+
+  // preamble lock cancels the RX_SINGLE symbol timeout
+  _rxTimeoutAt = 0;
+  _validHeaderAt = _air.start + (uint64_t)((preamble + 4.25) * tsym + 8 * tsym);
+  _rxDoneAt = _air.end;
+  if (_validHeaderAt > _rxDoneAt) {
+    _validHeaderAt = _rxDoneAt;
+  }
+
+  startHopping(_air.start, _rxDoneAt);
+}
+
+void SX1276Model::startHopping(uint64_t start, uint64_t end)
+{
+  uint8_t period = _regs[REG_HOP_PERIOD];
+
+  _hopCount = 0;
+  _hopAt = 0;
+  _regs[REG_HOP_CHANNEL] &= ~0x3f;
+
+  if (period == 0) {
+    return;
+  }
+
+  // preamble and header stay on the first channel, then one hop per period
+  uint64_t tsym = symbolTimeUs();
+  int preamble = (_regs[REG_PREAMBLE_MSB] << 8) | _regs[REG_PREAMBLE_LSB];
+
+  _hopEndAt = end;
+  _hopAt = start + (uint64_t)((preamble + 4.25) * tsym + 8 * tsym) + period * tsym;
+  if (_hopAt >= end) {
+    _hopAt = 0;
+  }
+}
+
+void SX1276Model::logDwell()
+{
+  if (_regs[REG_HOP_PERIOD] && _hopCount < sizeof(_hopFrf) / sizeof(_hopFrf[0])) {
+    _hopFrf[_hopCount++] = frf();
+  }
+}
+
+size_t SX1276Model::rxPayloadLength() const
+{
+  if (_regs[REG_MODEM_CONFIG_1] & 0x01) {
+    // implicit header, the receiver decides the length
+    return _regs[REG_PAYLOAD_LENGTH];
+  }
+
+  return _rxLength;
+}
+
+void SX1276Model::streamPayload(size_t count)
+{
+  while (_rxWritten < count) {
+    _fifo[_rxWritePtr++] = _rxWritten < _rxLength ? _rxBuffer[_rxWritten] : 0x00;
+    _rxWritten++;
+  }
+}
+
+void SX1276Model::streamToNow()
+{
+  uint64_t now = sim_time_us();
+
+  if (!_rxHeaderAt || !_rxDoneAt || now <= _rxHeaderAt) {
+    return;
+  }
+
+  // evenly spread over the payload symbols, a byte lands once fully decoded
+  size_t length = rxPayloadLength();
+  size_t count = now >= _rxDoneAt ? length : length * (now - _rxHeaderAt) / (_rxDoneAt - _rxHeaderAt);
+
+  streamPayload(count);
+}
+
+void SX1276Model::finishReception()
+{
+  size_t length = rxPayloadLength();
+
+  if (!_rxHeaderAt) {
+    _rxStart = _rxWritePtr;
+    _rxWritten = 0;
+  }
+
+  streamPayload(length);
+  _rxHeaderAt = 0;
+
+  uint8_t start = _rxStart;
+
+  _regs[REG_FIFO_RX_CURRENT_ADDR] = start;
+  _regs[REG_RX_NB_BYTES] = (uint8_t)length;
+  _regs[REG_PKT_SNR_VALUE] = (uint8_t)(int8_t)lroundf(_rxSnr * 4);
+  _regs[REG_PKT_RSSI_VALUE] = (uint8_t)(_rxRssi + (frf() < 0x834000 ? 164 : 157));
+  _regs[REG_MODEM_STAT] = (_regs[REG_MODEM_CONFIG_1] & 0x0e) << 4;
+  _regs[REG_HOP_CHANNEL] = (_regs[REG_MODEM_CONFIG_2] & 0x04) << 4;
+  // 20-bit two's complement, inverse of the datasheet formula (p. 37)
+  int32_t fei = (int32_t)lround(_frequencyError * 32e6 / (1 << 24) * 500000.0 / signalBandwidth());
+  _regs[REG_FREQ_ERROR_MSB] = (fei >> 16) & 0x0f;
+  _regs[REG_FREQ_ERROR_MID] = (fei >> 8) & 0xff;
+  _regs[REG_FREQ_ERROR_LSB] = fei & 0xff;
+
+  uint8_t flags = IRQ_RX_DONE_MASK;
+  if (_rxCrcError && (_regs[REG_MODEM_CONFIG_2] & 0x04)) {
+    flags |= IRQ_PAYLOAD_CRC_ERROR_MASK;
+  }
+
+  _rxLength = 0;
+  _rxCount++;
+
+  if (mode() == MODE_RX_SINGLE) {
+    setMode(MODE_STDBY);
+  }
+
+  setIrq(flags);
+}
+
+uint64_t SX1276Model::nextEventTime() const
+{
+  uint64_t next = 0;
+
+  next = earliest(next, _txDoneAt);
+  next = earliest(next, _cadDoneAt);
+  next = earliest(next, _validHeaderAt);
+  next = earliest(next, _rxDoneAt);
+  next = earliest(next, _rxTimeoutAt);
+  next = earliest(next, _hopAt);
+  next = earliest(next, _injectAt);
+
+  return next;
+}
+
+void SX1276Model::advanceTo(uint64_t now)
+{
+  for (;;) {
+    uint64_t next = nextEventTime();
+
+    if (next == 0 || next > now) {
+      return;
+    }
+
+    if (next == _injectAt) {
+      _injectAt = 0;
+      beginReception(_injectBuffer, _injectLength, next, frf(), -60, 9.0f, false);
+    } else if (next == _hopAt) {
+      // the dwell that just ended, then FhssPresentChannel moves on
+      logDwell();
+      _regs[REG_HOP_CHANNEL] = (_regs[REG_HOP_CHANNEL] & 0xc0) | ((_regs[REG_HOP_CHANNEL] + 1) & 0x3f);
+      _hopAt += _regs[REG_HOP_PERIOD] * symbolTimeUs();
+      if (_hopAt >= _hopEndAt) {
+        _hopAt = 0;
+      }
+      setIrq(IRQ_FHSS_CHANGE_MASK);
+    } else if (next == _txDoneAt) {
+      logDwell();
+      _txDoneAt = 0;
+      setMode(MODE_STDBY);
+      setIrq(IRQ_TX_DONE_MASK);
+    } else if (next == _cadDoneAt) {
+      _cadDoneAt = 0;
+      setMode(MODE_STDBY);
+      bool detected = _air.frf == frf() && _air.start <= next && _air.end > _cadStartAt;
+      setIrq(detected ? IRQ_CAD_DONE_MASK | IRQ_CAD_DETECTED_MASK : IRQ_CAD_DONE_MASK);
+    } else if (next == _validHeaderAt) {
+      _validHeaderAt = 0;
+      _rxHeaderAt = next;
+      _rxStart = _rxWritePtr;
+      _rxWritten = 0;
+      // the new frame's start address is readable from here on; the byte
+      // count still belongs to the last frame until RxDone
+      _regs[REG_FIFO_RX_CURRENT_ADDR] = _rxStart;
+      if (!(_regs[REG_MODEM_CONFIG_1] & 0x01)) {
+        setIrq(IRQ_VALID_HEADER_MASK);
+      }
+    } else if (next == _rxDoneAt) {
+      logDwell();
+      _rxDoneAt = 0;
+      finishReception();
+    } else if (next == _rxTimeoutAt) {
+      _rxTimeoutAt = 0;
+      setMode(MODE_STDBY);
+      setIrq(IRQ_RX_TIMEOUT_MASK);
+    }
+  }
+}
+
+void SX1276Model::setIrq(uint8_t mask)
+{
+  _regs[REG_IRQ_FLAGS] |= mask;
+  updateDio();
+}
+
+void SX1276Model::updateDio()
+{
+  static const uint8_t dio0Irqs[] = { IRQ_RX_DONE_MASK, IRQ_TX_DONE_MASK, IRQ_CAD_DONE_MASK, 0 };
+  static const uint8_t dio1Irqs[] = { IRQ_RX_TIMEOUT_MASK, IRQ_FHSS_CHANGE_MASK, IRQ_CAD_DETECTED_MASK, 0 };
+
+  uint8_t pending = _regs[REG_IRQ_FLAGS] & ~_regs[REG_IRQ_FLAGS_MASK];
+  uint8_t mapping = _regs[REG_DIO_MAPPING_1];
+
+  bool dio0 = (pending & dio0Irqs[(mapping >> 6) & 0x03]) != 0;
+  bool dio1 = (pending & dio1Irqs[(mapping >> 4) & 0x03]) != 0;
+
+  if (dio0 != _dio0Level) {
+    _dio0Level = dio0;
+    if (_dio0 >= 0) {
+      sim_gpio_drive(_dio0, dio0);
+    }
+  }
+
+  if (dio1 != _dio1Level) {
+    _dio1Level = dio1;
+    if (_dio1 >= 0) {
+      sim_gpio_drive(_dio1, dio1);
+    }
+  }
+}
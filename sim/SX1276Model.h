@@ -0,0 +1,175 @@
+#ifndef SX1276_MODEL_H
+#define SX1276_MODEL_H
+
+#include "pico.h"
+#include "hardware/spi.h"
+
+// Register-level behavioral model of an SX1276 in LoRa mode.
+//
+// The model sits behind the simulated SPI bus: it decodes the address byte of
+// every CS frame, auto-increments like the real chip (except on REG_FIFO) and
+// keeps the 256-byte FIFO, op-mode state machine, IRQ flags and DIO0/DIO1
+// mapping. TxDone, RxDone and CadDone are scheduled on the virtual clock from
+// the time-on-air of the current modem settings. Radios on the same frequency,
+// spreading factor, bandwidth and sync word hear each other's transmissions.
+
+class SX1276Model {
+public:
+  SX1276Model(spi_inst_t *spi, uint ss, int dio0 = -1, int dio1 = -1);
+  ~SX1276Model();
+
+  // power-on register defaults, FIFO cleared
+  void reset();
+
+  // put a frame on the air as seen by this radio only
+  void injectPacket(const uint8_t *buffer, size_t size, int rssi = -60, float snr = 9.0f, bool crcError = false);
+
+  // carrier offset reported in the FEI registers of the next received frames
+  void setFrequencyError(long hz) { _frequencyError = hz; }
+
+  // lose frames on the way to this radio: bit 0 is the next frame it would
+  // hear, bit 1 the one after, and so on
+  void dropFrames(uint32_t mask) { _dropMask = mask; }
+
+  // channel energy in REG_RSSI_VALUE, e.g. a non-LoRa interferer CAD cannot see
+  void setChannelRssi(int dbm) { _channelRssi = dbm; }
+
+  // same, starting later at the given sim_time_us()
+  void injectPacketAt(uint64_t time, const uint8_t *buffer, size_t size);
+
+  // same, on another channel: only a radio tuned there hears it
+  void injectPacketOn(long frequency, const uint8_t *buffer, size_t size, int rssi = -60, float snr = 9.0f);
+
+  uint8_t reg(uint8_t address) const { return _regs[address & 0x7f]; }
+  const uint8_t *fifo() const { return _fifo; }
+
+  // FRF of every dwell of the last hopping frame, in order
+  size_t hopCount() const { return _hopCount; }
+  uint32_t hopFrf(size_t index) const { return _hopFrf[index]; }
+
+  uint32_t spiTransactions() const { return _spiTransactions; }
+  uint32_t spiBytes() const { return _spiBytes; }
+  uint32_t txCount() const { return _txCount; }
+  uint32_t rxCount() const { return _rxCount; }
+  uint64_t listenTimeUs() const; // in RX or CAD since resetStats()
+  void resetStats();
+
+  uint32_t frf() const;
+  int spreadingFactor() const;
+  long signalBandwidth() const;
+  uint64_t timeOnAirUs(size_t payloadLength) const;
+
+  spi_inst_t *spi() const { return _spi; }
+  uint ss() const { return _ss; }
+
+  // bus side, driven by the SDK stubs
+  void select();
+  void deselect();
+  uint8_t transfer(uint8_t value);
+
+  // clock side, driven by the SDK stubs
+  uint64_t nextEventTime() const;
+  void advanceTo(uint64_t now);
+
+private:
+  void writeRegister(uint8_t address, uint8_t value);
+  uint8_t readRegister(uint8_t address);
+
+  void setMode(uint8_t mode);
+  void startTx();
+  void startRx(uint8_t mode);
+  void startCad();
+
+  void startHopping(uint64_t start, uint64_t end);
+  void logDwell();
+  void beginReception(const uint8_t *buffer, size_t size, uint64_t start, uint32_t frf, int rssi, float snr,
+                      bool crcError);
+  void lockAirFrame();
+  size_t rxPayloadLength() const;
+  void streamPayload(size_t count);
+  void streamToNow();
+  void finishReception();
+  bool hears(const SX1276Model &other) const;
+
+  void setIrq(uint8_t mask);
+  void updateDio();
+
+  uint8_t mode() const { return _regs[0x01] & 0x07; }
+  uint64_t symbolTimeUs() const;
+
+private:
+  spi_inst_t *_spi;
+  uint _ss;
+  int _dio0;
+  int _dio1;
+  bool _dio0Level;
+  bool _dio1Level;
+
+  uint8_t _regs[128];
+  uint8_t _fifo[256];
+
+  // current SPI frame
+  bool _selected;
+  int _frameIndex;
+  uint8_t _address;
+  bool _write;
+
+  // RX write pointer, REG_FIFO_RX_BYTE_ADDR
+  uint8_t _rxWritePtr;
+
+  // payload bytes reach the FIFO one by one between the header and RxDone
+  uint64_t _rxHeaderAt; // 0 = header not decoded yet
+  uint8_t _rxStart;
+  size_t _rxWritten;
+
+  // scheduled events, 0 = none
+  uint64_t _txDoneAt;
+  uint64_t _cadDoneAt;
+  uint64_t _validHeaderAt;
+  uint64_t _rxDoneAt;
+  uint64_t _rxTimeoutAt;
+  uint64_t _cadStartAt;
+  uint64_t _hopAt;
+  uint64_t _injectAt;
+  uint64_t _hopEndAt;
+
+  // FHSS dwell log
+  uint32_t _hopFrf[64];
+  size_t _hopCount;
+
+  // last frame put on the air around this radio; CAD sees it, and RX entered
+  // while its preamble is still going catches it
+  struct AirFrame {
+    uint8_t data[256];
+    size_t length;
+    uint64_t start;
+    uint64_t end;
+    uint32_t frf;
+    int rssi;
+    float snr;
+    bool crcError;
+  } _air;
+
+  // frame waiting for injectPacketAt()
+  uint8_t _injectBuffer[256];
+  size_t _injectLength;
+
+  // frame currently being received
+  uint8_t _rxBuffer[256];
+  size_t _rxLength;
+  int _rxRssi;
+  float _rxSnr;
+  bool _rxCrcError;
+  long _frequencyError;
+  int _channelRssi;
+  uint32_t _dropMask;
+
+  uint32_t _spiTransactions;
+  uint32_t _spiBytes;
+  uint32_t _txCount;
+  uint32_t _rxCount;
+  uint64_t _listenUs;
+  uint64_t _modeSince;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef PICO_SIM_SPI_H
+#define PICO_SIM_SPI_H
+
+#include "pico.h"
+
+typedef struct {
+  volatile uint32_t cr0;
+  volatile uint32_t cr1;
+  volatile uint32_t dr;
+} spi_hw_t;
+
+typedef struct spi_inst {
+  uint index;
+  uint baudrate;
+  spi_hw_t hw;
+} spi_inst_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern spi_inst_t sim_spi_instances[2];
+
+#define spi0 (&sim_spi_instances[0])
+#define spi1 (&sim_spi_instances[1])
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_deinit(spi_inst_t *spi);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t *spi);
+uint spi_get_index(const spi_inst_t *spi);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
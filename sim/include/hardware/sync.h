@@ -0,0 +1,35 @@
+#ifndef PICO_SIM_SYNC_H
+#define PICO_SIM_SYNC_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// waiting for an event hands the host thread to the other core
+void __wfe(void);
+void __sev(void);
+void __dmb(void);
+
+// masks every interrupt of the simulated core, DMA and GPIO IRQs raised
+// meanwhile are delivered on restore
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+// one host thread plays both cores and they only switch in waits, so a spin
+// lock is just the interrupt mask plus a check that it is not taken twice
+typedef volatile uint32_t spin_lock_t;
+
+int spin_lock_claim_unused(bool required);
+spin_lock_t *spin_lock_instance(uint lock_num);
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+
+uint get_core_num(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
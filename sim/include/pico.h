@@ -0,0 +1,32 @@
+#ifndef PICO_SIM_PICO_H
+#define PICO_SIM_PICO_H
+
+// Minimal stand-in for the Pico SDK base header, used by the host simulator build.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+#define NUM_BANK0_GPIOS  30
+#define NUM_DMA_CHANNELS 12
+#define NUM_SPIS         2
+#define NUM_SPIN_LOCKS   32
+
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// spinning costs virtual time too, otherwise busy-wait loops never end
+void tight_loop_contents(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef PICO_SIM_BINARY_INFO_H
+#define PICO_SIM_BINARY_INFO_H
+
+// picotool metadata has no meaning on the host
+#define bi_decl(...)
+#define bi_3pins_with_func(...)
+#define bi_1pin_with_name(...)
+#define bi_3pins_with_names(...)
+
+#endif
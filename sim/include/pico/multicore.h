@@ -0,0 +1,21 @@
+#ifndef PICO_SIM_MULTICORE_H
+#define PICO_SIM_MULTICORE_H
+
+#include "pico.h"
+
+// Core1 runs as a coroutine on the host thread. The cores switch whenever the
+// running one sleeps, spins or waits for an event, so shared data only needs
+// the same care it would on hardware.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
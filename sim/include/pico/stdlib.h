@@ -0,0 +1,18 @@
+#ifndef PICO_SIM_STDLIB_H
+#define PICO_SIM_STDLIB_H
+
+#include "pico.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool stdio_init_all(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PICO_SIM_TIME_H
+#define PICO_SIM_TIME_H
+
+#include "pico.h"
+
+// Time is virtual: it only moves when the firmware sleeps, spins or clocks SPI bytes.
+
+typedef uint64_t absolute_time_t;
+
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint64_t to_us_since_boot(absolute_time_t t);
+absolute_time_t from_us_since_boot(uint64_t us);
+absolute_time_t make_timeout_time_us(uint64_t us);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+bool time_reached(absolute_time_t t);
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void sleep_until(absolute_time_t t);
+void busy_wait_us(uint64_t us);
+
+// sleeps until an event (__sev, an interrupt) or the timeout, true on timeout
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp);
+
+// default alarm pool: callbacks run like interrupt handlers, a positive
+// return value reschedules that many us after the previous target, a
+// negative one that many us from now
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,975 @@
+#include "pico_sim.h"
+#include "SX1276Model.h"
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/spi.h"
+#include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <ucontext.h>
+
+// Pico SDK stand-ins for the host build. Only the calls made by the LoRa
+// driver and the examples are provided, with just enough behaviour for the
+// SX1276 model: GPIO levels and edge interrupts, byte-level SPI, DMA that
+// completes on start, a virtual clock in nanoseconds and a cooperative core1.
+
+#define DREQ_SPI0_TX 16
+#define DREQ_SPI0_RX 17
+#define DREQ_SPI1_TX 18
+#define DREQ_SPI1_RX 19
+#define DREQ_FORCE   0x3f
+
+spi_inst_t sim_spi_instances[2] = {
+  { 0, 0, { 0, 0, 0 } },
+  { 1, 0, { 0, 0, 0 } },
+};
+
+struct sim_gpio {
+  bool out;
+  bool level;
+  uint32_t irqMask;
+};
+
+struct sim_dma_channel {
+  bool claimed;
+  dma_channel_config config;
+  volatile void *writeAddr;
+  const volatile void *readAddr;
+  uint count;
+  bool irq0Enabled;
+  bool irq0Status;
+};
+
+static uint64_t nowNs = 0;
+
+static sim_gpio gpios[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpioCallback = NULL;
+static std::deque<std::pair<uint, uint32_t> > pendingGpioIrqs;
+static bool inIrq = false;
+static bool irqsDisabled = false;
+static uint32_t busCollisions = 0;
+
+// function-local so radios defined as globals elsewhere can attach during static init
+static std::vector<SX1276Model *> &radioList()
+{
+  static std::vector<SX1276Model *> list;
+  return list;
+}
+static SX1276Model *defaultRadio = NULL;
+
+static ucontext_t core0Context;
+static ucontext_t core1Context;
+static std::vector<uint8_t> core1Stack;
+static void (*core1Entry)(void) = NULL;
+static bool core1Running = false;
+static bool onCore1 = false;
+static bool eventPending[2];
+
+struct sim_alarm {
+  alarm_id_t id;
+  uint64_t time;
+  alarm_callback_t callback;
+  void *userData;
+};
+
+static std::vector<sim_alarm> alarms;
+static alarm_id_t lastAlarmId = 0;
+
+static sim_dma_channel dmaChannels[NUM_DMA_CHANNELS];
+static std::vector<irq_handler_t> irqHandlers[32];
+static bool irqEnabled[32];
+static bool irqPending[32];
+
+static void deliverPendingIrqs();
+
+// --- simulator control ------------------------------------------------------
+
+void sim_attach_radio(SX1276Model *radio)
+{
+  radioList().push_back(radio);
+}
+
+void sim_detach_radio(SX1276Model *radio)
+{
+  radioList().erase(std::remove(radioList().begin(), radioList().end(), radio), radioList().end());
+
+  if (radio == defaultRadio) {
+    defaultRadio = NULL;
+  }
+}
+
+SX1276Model *sim_default_radio()
+{
+  if (!defaultRadio) {
+    const char *dio0 = getenv("LORA_SIM_DIO0");
+
+    defaultRadio = new SX1276Model(spi0, 8, dio0 ? atoi(dio0) : 7);
+  }
+
+  return defaultRadio;
+}
+
+SX1276Model *sim_radio(size_t index)
+{
+  return index < radioList().size() ? radioList()[index] : NULL;
+}
+
+static void ensureRadio()
+{
+  // firmware that never attached a radio gets one wired like the examples
+  if (radioList().empty()) {
+    sim_default_radio();
+  }
+}
+
+// a chip select nobody drives yet is pulled up on the module
+static bool selected(const SX1276Model *radio)
+{
+  return gpios[radio->ss()].out && !gpios[radio->ss()].level;
+}
+
+static bool fireAlarm()
+{
+  uint64_t now = nowNs / 1000;
+
+  for (size_t i = 0; i < alarms.size(); i++) {
+    if (alarms[i].time > now) {
+      continue;
+    }
+
+    sim_alarm alarm = alarms[i];
+    alarms.erase(alarms.begin() + i);
+
+    inIrq = true;
+    int64_t again = alarm.callback(alarm.id, alarm.userData);
+    inIrq = false;
+
+    if (again != 0) {
+      alarm.time = again > 0 ? alarm.time + again : nowNs / 1000 - again;
+      alarms.push_back(alarm);
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+static void deliverIrqs()
+{
+  // no nesting; like the real core, an SPI frame in progress does not hold
+  // interrupts back, only a disabled mask does
+  if (inIrq || irqsDisabled) {
+    return;
+  }
+
+  do {
+    // DMA completions raised by the last handler
+    deliverPendingIrqs();
+
+    while (!pendingGpioIrqs.empty()) {
+      std::pair<uint, uint32_t> irq = pendingGpioIrqs.front();
+      pendingGpioIrqs.pop_front();
+
+      if (gpioCallback && (gpios[irq.first].irqMask & irq.second)) {
+        inIrq = true;
+        gpioCallback(irq.first, irq.second);
+        inIrq = false;
+      }
+    }
+
+    // then the timer IRQ, one alarm at a time since a callback may add or
+    // cancel the others
+  } while (fireAlarm());
+}
+
+static uint64_t nextRadioEvent()
+{
+  uint64_t next = 0;
+
+  for (size_t i = 0; i < radioList().size(); i++) {
+    uint64_t t = radioList()[i]->nextEventTime();
+    if (t != 0 && (next == 0 || t < next)) {
+      next = t;
+    }
+  }
+
+  return next;
+}
+
+// radio event or alarm still ahead of the clock; alarms already due wait
+// for deliverIrqs()
+static uint64_t nextEvent()
+{
+  uint64_t next = nextRadioEvent();
+
+  for (size_t i = 0; i < alarms.size(); i++) {
+    uint64_t t = alarms[i].time;
+    if (t * 1000 > nowNs && (next == 0 || t < next)) {
+      next = t;
+    }
+  }
+
+  return next;
+}
+
+static void advanceTo(uint64_t targetNs)
+{
+  for (;;) {
+    uint64_t next = nextEvent();
+
+    if (next == 0 || next * 1000 > targetNs) {
+      break;
+    }
+
+    if (next * 1000 > nowNs) {
+      nowNs = next * 1000;
+    }
+
+    for (size_t i = 0; i < radioList().size(); i++) {
+      radioList()[i]->advanceTo(nowNs / 1000);
+    }
+
+    deliverIrqs();
+  }
+
+  if (targetNs > nowNs) {
+    nowNs = targetNs;
+  }
+
+  deliverIrqs();
+}
+
+void sim_advance_us(uint64_t us)
+{
+  advanceTo(nowNs + us * 1000);
+}
+
+void sim_gpio_drive(uint gpio, bool level)
+{
+  bool previous = gpios[gpio].level;
+
+  gpios[gpio].level = level;
+
+  if (!previous && level) {
+    pendingGpioIrqs.push_back(std::make_pair(gpio, (uint32_t)GPIO_IRQ_EDGE_RISE));
+  } else if (previous && !level) {
+    pendingGpioIrqs.push_back(std::make_pair(gpio, (uint32_t)GPIO_IRQ_EDGE_FALL));
+  }
+}
+
+uint32_t sim_bus_collisions()
+{
+  return busCollisions;
+}
+
+uint64_t sim_time_us()
+{
+  return nowNs / 1000;
+}
+
+// --- core switching ---------------------------------------------------------
+
+static void core1Trampoline()
+{
+  core1Entry();
+
+  // falling off the entry point parks core1, uc_link resumes core0
+  core1Running = false;
+  onCore1 = false;
+}
+
+static void yieldCore()
+{
+  // interrupt handlers run to completion on whichever core took them
+  if (inIrq || !core1Running) {
+    return;
+  }
+
+  if (onCore1) {
+    onCore1 = false;
+    swapcontext(&core1Context, &core0Context);
+  } else {
+    onCore1 = true;
+    swapcontext(&core0Context, &core1Context);
+  }
+}
+
+// --- pico/multicore ---------------------------------------------------------
+
+void multicore_launch_core1(void (*entry)(void))
+{
+  core1Stack.assign(256 * 1024, 0);
+  core1Entry = entry;
+
+  getcontext(&core1Context);
+  core1Context.uc_stack.ss_sp = core1Stack.data();
+  core1Context.uc_stack.ss_size = core1Stack.size();
+  core1Context.uc_link = &core0Context;
+  makecontext(&core1Context, core1Trampoline, 0);
+
+  core1Running = true;
+}
+
+void multicore_reset_core1(void)
+{
+  // only core0 can reset core1, it simply never gets switched to again
+  core1Running = false;
+}
+
+// --- hardware/sync ----------------------------------------------------------
+
+void __wfe(void)
+{
+  uint core = onCore1 ? 1 : 0;
+
+  if (!eventPending[core]) {
+    sim_advance_us(1);
+    yieldCore();
+  }
+
+  eventPending[core] = false;
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp)
+{
+  uint core = onCore1 ? 1 : 0;
+
+  // jump straight to the next thing that could wake the core
+  while (!eventPending[core]) {
+    uint64_t now = sim_time_us();
+    uint64_t next = nextEvent();
+
+    if (now >= timeout_timestamp) {
+      return true;
+    }
+
+    if (next == 0 || next > timeout_timestamp) {
+      next = timeout_timestamp;
+    }
+    if (next <= now) {
+      next = now + 1;
+    }
+
+    sim_advance_us(next - now);
+    yieldCore();
+  }
+
+  eventPending[core] = false;
+
+  return false;
+}
+
+void __sev(void)
+{
+  eventPending[0] = true;
+  eventPending[1] = true;
+}
+
+void __dmb(void)
+{
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+  uint32_t status = irqsDisabled;
+
+  irqsDisabled = true;
+
+  return status;
+}
+
+void restore_interrupts(uint32_t status)
+{
+  irqsDisabled = status != 0;
+
+  deliverIrqs();
+}
+
+static spin_lock_t spinLocks[NUM_SPIN_LOCKS];
+static bool spinLockClaimed[NUM_SPIN_LOCKS];
+
+int spin_lock_claim_unused(bool required)
+{
+  for (uint i = 0; i < NUM_SPIN_LOCKS; i++) {
+    if (!spinLockClaimed[i]) {
+      spinLockClaimed[i] = true;
+      return (int)i;
+    }
+  }
+
+  if (required) {
+    fprintf(stderr, "pico_sim: no spin lock available\n");
+    abort();
+  }
+
+  return -1;
+}
+
+spin_lock_t *spin_lock_instance(uint lock_num)
+{
+  return &spinLocks[lock_num];
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock)
+{
+  uint32_t status = save_and_disable_interrupts();
+
+  // with a single thread a lock already held can never be released
+  if (*lock) {
+    fprintf(stderr, "pico_sim: spin lock taken twice\n");
+    abort();
+  }
+  *lock = 1;
+
+  return status;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq)
+{
+  *lock = 0;
+  restore_interrupts(saved_irq);
+}
+
+uint get_core_num(void)
+{
+  return onCore1 ? 1 : 0;
+}
+
+// --- pico/time --------------------------------------------------------------
+
+uint64_t time_us_64(void)
+{
+  // reading the timer costs a little time, so polling loops make progress
+  advanceTo(nowNs + 100);
+
+  return nowNs / 1000;
+}
+
+uint32_t time_us_32(void)
+{
+  return (uint32_t)time_us_64();
+}
+
+absolute_time_t get_absolute_time(void)
+{
+  return time_us_64();
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t)
+{
+  return (uint32_t)(t / 1000);
+}
+
+uint64_t to_us_since_boot(absolute_time_t t)
+{
+  return t;
+}
+
+absolute_time_t from_us_since_boot(uint64_t us)
+{
+  return us;
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us)
+{
+  return time_us_64() + us;
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+  return time_us_64() + (uint64_t)ms * 1000;
+}
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+  return (int64_t)(to - from);
+}
+
+bool time_reached(absolute_time_t t)
+{
+  return time_us_64() >= t;
+}
+
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+  sim_alarm alarm = { ++lastAlarmId, time, callback, user_data };
+
+  if (time <= sim_time_us()) {
+    if (!fire_if_past) {
+      return 0;
+    }
+
+    // the SDK runs it right away, still as an interrupt
+    bool nested = inIrq;
+    inIrq = true;
+    int64_t again = callback(alarm.id, user_data);
+    inIrq = nested;
+
+    if (again == 0) {
+      return 0;
+    }
+    alarm.time = again > 0 ? time + again : sim_time_us() - again;
+  }
+
+  alarms.push_back(alarm);
+
+  return alarm.id;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+  return add_alarm_at(time_us_64() + us, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+  for (size_t i = 0; i < alarms.size(); i++) {
+    if (alarms[i].id == alarm_id) {
+      alarms.erase(alarms.begin() + i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void sleep_us(uint64_t us)
+{
+  sim_advance_us(us);
+  yieldCore();
+}
+
+void sleep_ms(uint32_t ms)
+{
+  sim_advance_us((uint64_t)ms * 1000);
+  yieldCore();
+}
+
+void sleep_until(absolute_time_t t)
+{
+  uint64_t now = sim_time_us();
+
+  if (t > now) {
+    sleep_us(t - now);
+  }
+}
+
+void busy_wait_us(uint64_t us)
+{
+  sim_advance_us(us);
+  yieldCore();
+}
+
+void tight_loop_contents(void)
+{
+  sim_advance_us(1);
+  yieldCore();
+}
+
+bool stdio_init_all(void)
+{
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  return true;
+}
+
+// --- hardware/gpio ----------------------------------------------------------
+
+void gpio_init(uint gpio)
+{
+  gpios[gpio].out = false;
+  gpios[gpio].level = false;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+  gpios[gpio].out = out;
+}
+
+void gpio_put(uint gpio, bool value)
+{
+  ensureRadio();
+
+  bool edge = gpios[gpio].level != value;
+
+  gpios[gpio].level = value;
+
+  // only an edge on CS starts or ends a frame, driving it low again does not
+  for (size_t i = 0; edge && i < radioList().size(); i++) {
+    if (radioList()[i]->ss() == gpio) {
+      if (value) {
+        radioList()[i]->deselect();
+      } else {
+        radioList()[i]->select();
+      }
+    }
+  }
+
+  if (value) {
+    deliverIrqs();
+  }
+}
+
+bool gpio_get(uint gpio)
+{
+  return gpios[gpio].level;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+  (void)gpio;
+  (void)fn;
+}
+
+void gpio_pull_up(uint gpio)
+{
+  (void)gpio;
+}
+
+void gpio_pull_down(uint gpio)
+{
+  (void)gpio;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled)
+{
+  if (enabled) {
+    gpios[gpio].irqMask |= event_mask;
+  } else {
+    gpios[gpio].irqMask &= ~event_mask;
+  }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback)
+{
+  gpio_set_irq_enabled(gpio, event_mask, enabled);
+
+  if (enabled) {
+    gpioCallback = callback;
+  }
+}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t event_mask)
+{
+  (void)gpio;
+  (void)event_mask;
+}
+
+// --- hardware/spi -----------------------------------------------------------
+
+static uint8_t spiTransfer(spi_inst_t *spi, uint8_t value)
+{
+  uint8_t response = 0x00;
+  int listeners = 0;
+
+  ensureRadio();
+
+  for (size_t i = 0; i < radioList().size(); i++) {
+    if (radioList()[i]->spi() == spi && selected(radioList()[i])) {
+      response = radioList()[i]->transfer(value);
+      listeners++;
+    }
+  }
+
+  // both radios take the byte and drive MISO against each other
+  if (listeners > 1) {
+    busCollisions++;
+  }
+
+  // eight clocks per byte
+  if (spi->baudrate) {
+    advanceTo(nowNs + 8000000000ull / spi->baudrate);
+  }
+
+  return response;
+}
+
+uint spi_init(spi_inst_t *spi, uint baudrate)
+{
+  spi->baudrate = baudrate;
+  return baudrate;
+}
+
+void spi_deinit(spi_inst_t *spi)
+{
+  spi->baudrate = 0;
+}
+
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate)
+{
+  spi->baudrate = baudrate;
+  return baudrate;
+}
+
+uint spi_get_baudrate(const spi_inst_t *spi)
+{
+  return spi->baudrate;
+}
+
+uint spi_get_index(const spi_inst_t *spi)
+{
+  return spi->index;
+}
+
+spi_hw_t *spi_get_hw(spi_inst_t *spi)
+{
+  return &spi->hw;
+}
+
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx)
+{
+  return spi->index == 0 ? (is_tx ? DREQ_SPI0_TX : DREQ_SPI0_RX) : (is_tx ? DREQ_SPI1_TX : DREQ_SPI1_RX);
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    spiTransfer(spi, src[i]);
+  }
+
+  return (int)len;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = spiTransfer(spi, repeated_tx_data);
+  }
+
+  return (int)len;
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = spiTransfer(spi, src[i]);
+  }
+
+  return (int)len;
+}
+
+// --- hardware/irq -----------------------------------------------------------
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority)
+{
+  (void)order_priority;
+  irqHandlers[num].push_back(handler);
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler)
+{
+  std::vector<irq_handler_t> &handlers = irqHandlers[num];
+  handlers.erase(std::remove(handlers.begin(), handlers.end(), handler), handlers.end());
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+  irqEnabled[num] = enabled;
+}
+
+static void raiseIrq(uint num)
+{
+  if (!irqEnabled[num]) {
+    return;
+  }
+
+  // every IRQ has the default priority: one raised inside a handler, or with
+  // interrupts disabled, waits until it can run
+  if (inIrq || irqsDisabled) {
+    irqPending[num] = true;
+    return;
+  }
+
+  inIrq = true;
+
+  for (size_t i = 0; i < irqHandlers[num].size(); i++) {
+    irqHandlers[num][i]();
+  }
+
+  inIrq = false;
+}
+
+static void deliverPendingIrqs()
+{
+  for (uint num = 0; num < 32; num++) {
+    if (irqPending[num]) {
+      irqPending[num] = false;
+      raiseIrq(num);
+    }
+  }
+}
+
+// --- hardware/dma -----------------------------------------------------------
+
+int dma_claim_unused_channel(bool required)
+{
+  for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+    if (!dmaChannels[i].claimed) {
+      dmaChannels[i].claimed = true;
+      return (int)i;
+    }
+  }
+
+  if (required) {
+    fprintf(stderr, "pico_sim: no DMA channel available\n");
+    abort();
+  }
+
+  return -1;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+  dmaChannels[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+  (void)channel;
+
+  dma_channel_config c;
+  c.size = DMA_SIZE_32;
+  c.read_increment = true;
+  c.write_increment = false;
+  c.dreq = DREQ_FORCE;
+  return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+  c->size = size;
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+  c->dreq = dreq;
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+  c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+  c->write_increment = incr;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+  dmaChannels[channel].config = *config;
+  dmaChannels[channel].writeAddr = write_addr;
+  dmaChannels[channel].readAddr = read_addr;
+  dmaChannels[channel].count = transfer_count;
+
+  if (trigger) {
+    dma_start_channel_mask(1u << channel);
+  }
+}
+
+static spi_inst_t *spiForDreq(uint dreq)
+{
+  if (dreq == DREQ_SPI0_TX || dreq == DREQ_SPI0_RX) {
+    return spi0;
+  }
+  if (dreq == DREQ_SPI1_TX || dreq == DREQ_SPI1_RX) {
+    return spi1;
+  }
+  return NULL;
+}
+
+void dma_start_channel_mask(uint32_t chan_mask)
+{
+  int tx = -1;
+  int rx = -1;
+
+  for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+    if (!(chan_mask & (1u << i))) {
+      continue;
+    }
+
+    sim_dma_channel &ch = dmaChannels[i];
+    uint dreq = ch.config.dreq;
+
+    if (dreq == DREQ_SPI0_TX || dreq == DREQ_SPI1_TX) {
+      tx = i;
+    } else if (dreq == DREQ_SPI0_RX || dreq == DREQ_SPI1_RX) {
+      rx = i;
+    } else {
+      // memory to memory, byte-wise is enough for the driver
+      const volatile uint8_t *src = (const volatile uint8_t *)ch.readAddr;
+      volatile uint8_t *dst = (volatile uint8_t *)ch.writeAddr;
+      uint width = 1u << ch.config.size;
+
+      for (uint n = 0; n < ch.count; n++) {
+        for (uint b = 0; b < width; b++) {
+          dst[b] = src[b];
+        }
+        if (ch.config.read_increment) src += width;
+        if (ch.config.write_increment) dst += width;
+      }
+      ch.irq0Status = true;
+    }
+  }
+
+  if (tx >= 0) {
+    sim_dma_channel &txc = dmaChannels[tx];
+    sim_dma_channel *rxc = rx >= 0 ? &dmaChannels[rx] : NULL;
+    spi_inst_t *spi = spiForDreq(txc.config.dreq);
+
+    const volatile uint8_t *src = (const volatile uint8_t *)txc.readAddr;
+    volatile uint8_t *dst = rxc ? (volatile uint8_t *)rxc->writeAddr : NULL;
+
+    for (uint n = 0; n < txc.count; n++) {
+      uint8_t response = spiTransfer(spi, *src);
+
+      if (dst) {
+        *dst = response;
+      }
+      if (txc.config.read_increment) src++;
+      if (rxc && rxc->config.write_increment) dst++;
+    }
+
+    txc.irq0Status = true;
+    if (rxc) {
+      rxc->irq0Status = true;
+    }
+  }
+
+  for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+    if ((chan_mask & (1u << i)) && dmaChannels[i].irq0Enabled) {
+      raiseIrq(DMA_IRQ_0);
+      break;
+    }
+  }
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+  (void)channel;
+  return false;
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled)
+{
+  dmaChannels[channel].irq0Enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(uint channel)
+{
+  return dmaChannels[channel].irq0Status;
+}
+
+void dma_channel_acknowledge_irq0(uint channel)
+{
+  dmaChannels[channel].irq0Status = false;
+}
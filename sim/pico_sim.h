@@ -0,0 +1,35 @@
+#ifndef PICO_SIM_H
+#define PICO_SIM_H
+
+#include "pico.h"
+#include "hardware/spi.h"
+
+// Host-side control of the simulated RP2040: virtual clock, GPIO levels and
+// the SX1276 models hanging off the SPI buses.
+
+class SX1276Model;
+
+// attach a radio to a bus, the radio answers while its CS pin is low
+void sim_attach_radio(SX1276Model *radio);
+void sim_detach_radio(SX1276Model *radio);
+
+// radio used when firmware talks to a bus nobody was attached to, wired like
+// the examples (spi0, CS 8, DIO0 from $LORA_SIM_DIO0 or 7)
+SX1276Model *sim_default_radio();
+
+// iterate attached radios, NULL past the end
+SX1276Model *sim_radio(size_t index);
+
+// current virtual time, without the cost time_us_64() charges the firmware
+uint64_t sim_time_us();
+
+// move the virtual clock, firing radio events and GPIO interrupts on the way
+void sim_advance_us(uint64_t us);
+
+// drive an input pin, used by the radio models for their DIO lines
+void sim_gpio_drive(uint gpio, bool level);
+
+// bytes clocked while two radios on the same bus were selected
+uint32_t sim_bus_collisions();
+
+#endif